@@ -0,0 +1,646 @@
+/* Kernel microbenchmark and regression check.
+ *
+ * On the board this is an app like the others and reports CPU cycles. On Linux the C
+ * reference kernels build on their own and report ns:
+ *
+ *     cc -O2 -o bench bench.c tone_gen.c -lm
+ *     cc -O2 -DBENCH_OPUS=1 $(pkg-config --cflags opus) -o bench bench.c tone_gen.c $(pkg-config --libs opus) -lm
+ *
+ * Every optimized variant is compared against the reference output, a mismatch fails the
+ * run and the host build exits with 1. Timings are gated against bench_baseline.h: on the
+ * board the cycle counts themselves, on Linux only each variant's time as a percentage of
+ * its ref from the same run, as absolute ns do not carry over between runs of a shared
+ * machine. A slowdown past the threshold fails the run too. A timing without a baseline is
+ * not gated, it shows as NO BASELINE and the run says so at the start and the end.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_dsp.h"
+#include "sdkconfig.h"
+#ifndef BENCH_OPUS
+#define BENCH_OPUS (1)
+#endif
+#else
+#include <time.h>
+#define ESP_LOGI(tag, fmt, ...) printf("I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) printf("W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, fmt, ...) printf("E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#endif
+
+#ifndef BENCH_OPUS
+#define BENCH_OPUS (0)
+#endif
+#if BENCH_OPUS
+#include "opus.h"
+#endif
+
+#include "tone_gen.h"
+#include "bench_baseline.h"
+
+static const char *TAG = "BENCH";
+
+// the shapes cb_fft in fft.c runs with: a 1024 tap window and 1024 complex points per block
+#define BENCH_N (1024)
+#define BENCH_RUNS (21)
+// fixed point FFTs round differently, the reference and esp-dsp agree to this much
+#define BENCH_FFT_SNR_DB (30.0)
+#define BENCH_SPECTRUM_TOL_DB (0.01)
+#define BENCH_OPUS_RATE (16000)
+#define BENCH_OPUS_FRAME (BENCH_OPUS_RATE / 50)
+#define BENCH_OPUS_FRAMES (50)
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#ifdef ESP_PLATFORM
+#define BENCH_PLATFORM CONFIG_IDF_TARGET
+#define BENCH_UNIT "cycles"
+#define BENCH_BASELINE bench_baseline_device
+#define BENCH_REGRESSION BENCH_REGRESSION_PCT
+#define BENCH_GATE_RATIO (0)
+#define BENCH_GATE_UNIT "cycles"
+
+static inline uint32_t bench_now(void)
+{
+    return esp_cpu_get_cycle_count();
+}
+#else
+#define BENCH_PLATFORM "host"
+#define BENCH_UNIT "ns"
+#define BENCH_BASELINE bench_baseline_host
+#define BENCH_REGRESSION BENCH_REGRESSION_PCT_HOST
+#define BENCH_GATE_RATIO (1)
+#define BENCH_GATE_UNIT "% of ref"
+
+static inline uint32_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+#endif
+
+typedef struct {
+    const char  *variant;
+    void        (*run)(void);
+} bench_variant_t;
+
+typedef struct {
+    const char      *name;
+    void            *out;                   /*!< Output compared between variants */
+    int             out_size;
+    void            (*setup)(void);         /*!< Fresh input, outside the timed region */
+    bool            (*check)(const void *ref, const void *out, double *err);
+    bool            (*verify)(double *err); /*!< Checks the reference itself, NULL when there is nothing to check it against */
+    bench_variant_t variants[3];            /*!< variants[0] is the reference */
+} bench_kernel_t;
+
+static int16_t input[BENCH_N * 2] __attribute__((aligned(16)));
+static int16_t window[BENCH_N] __attribute__((aligned(16)));
+static int16_t windowed[BENCH_N * 2] __attribute__((aligned(16)));
+static int16_t spectrum_in[BENCH_N * 2] __attribute__((aligned(16)));
+static int16_t work[BENCH_N * 2] __attribute__((aligned(16)));
+static int16_t twiddle[BENCH_N];
+static float spec[BENCH_N];
+static volatile int peak_index;
+static uint8_t ref_buf[BENCH_N * 2 * sizeof(int16_t)];
+
+/* ---- C reference kernels ---- */
+
+static void ref_mul_s16(void)
+{
+    for (int i = 0; i < BENCH_N; i++) {
+        work[i] = ((int32_t)work[i] * window[i]) >> 15;
+    }
+}
+
+// radix 2 decimation in frequency, natural order in, bit reversed order out, halved every
+// stage so the result is the DFT / N like dsps_fft2r_sc16
+static void ref_fft2r_sc16(void)
+{
+    for (int len = BENCH_N; len >= 2; len >>= 1) {
+        int half = len / 2;
+        int step = BENCH_N / len;
+        for (int start = 0; start < BENCH_N; start += len) {
+            for (int k = 0; k < half; k++) {
+                int16_t *a = &work[2 * (start + k)];
+                int16_t *b = &work[2 * (start + k + half)];
+                int32_t dr = (a[0] - b[0]) >> 1;
+                int32_t di = (a[1] - b[1]) >> 1;
+                int32_t wr = twiddle[2 * k * step];
+                int32_t wi = twiddle[2 * k * step + 1];
+                a[0] = (a[0] + b[0]) >> 1;
+                a[1] = (a[1] + b[1]) >> 1;
+                b[0] = (dr * wr - di * wi + 0x4000) >> 15;
+                b[1] = (dr * wi + di * wr + 0x4000) >> 15;
+            }
+        }
+    }
+}
+
+static int bit_reverse(int i, int bits)
+{
+    int j = 0;
+    for (int b = 0; b < bits; b++) {
+        if (i & (1 << b)) {
+            j |= 1 << (bits - 1 - b);
+        }
+    }
+    return j;
+}
+
+static int log2_n(void)
+{
+    int bits = 0;
+    while ((1 << bits) < BENCH_N) {
+        bits++;
+    }
+    return bits;
+}
+
+static void ref_bit_rev_sc16(void)
+{
+    int bits = log2_n();
+    for (int i = 0; i < BENCH_N; i++) {
+        int j = bit_reverse(i, bits);
+        if (i < j) {
+            int16_t re = work[2 * i];
+            int16_t im = work[2 * i + 1];
+            work[2 * i] = work[2 * j];
+            work[2 * i + 1] = work[2 * j + 1];
+            work[2 * j] = re;
+            work[2 * j + 1] = im;
+        }
+    }
+}
+
+// the magnitude, log and smoothing loop of cb_fft as it is written there
+static void ref_spectrum(void)
+{
+    int16_t *audio_buffer = work;
+    float largest = audio_buffer[0]*audio_buffer[0];
+    int index = 0;
+    for (int i = 0 ; i < BENCH_N ; i++) {
+        float spectrum_sqr = audio_buffer[i] * audio_buffer[i];
+        if( spectrum_sqr>largest){
+            largest = spectrum_sqr;
+            index = i;
+        }
+        float spectrum_dB = 10 * log10f(0.1 + spectrum_sqr);
+        spectrum_dB = 4 * spectrum_dB;
+        spec[i] = 0.8 * spec[i] + 0.2 * spectrum_dB;
+    }
+    peak_index = index;
+}
+
+/* ---- optimized variants ---- */
+
+// same loop in single precision, the double constants above go through soft float on the ESP32
+static void opt_spectrum(void)
+{
+    float largest = (float)work[0] * work[0];
+    int index = 0;
+    for (int i = 0; i < BENCH_N; i++) {
+        float sqr = (float)work[i] * work[i];
+        if (sqr > largest) {
+            largest = sqr;
+            index = i;
+        }
+        spec[i] = 0.8f * spec[i] + 0.2f * 40.0f * log10f(0.1f + sqr);
+    }
+    peak_index = index;
+}
+
+#ifdef ESP_PLATFORM
+static void ansi_mul_s16(void)
+{
+    dsps_mul_s16_ansi(work, window, work, BENCH_N, 1, 1, 1, 15);
+}
+
+static void opt_mul_s16(void)
+{
+    dsps_mul_s16(work, window, work, BENCH_N, 1, 1, 1, 15);
+}
+
+static void ansi_fft2r_sc16(void)
+{
+    dsps_fft2r_sc16_ansi(work, BENCH_N);
+}
+
+static void opt_fft2r_sc16(void)
+{
+    dsps_fft2r_sc16(work, BENCH_N);
+}
+
+static void ansi_bit_rev_sc16(void)
+{
+    dsps_bit_rev_sc16_ansi(work, BENCH_N);
+}
+#endif
+
+/* ---- inputs and checks ---- */
+
+static void setup_raw(void)
+{
+    memcpy(work, input, sizeof(work));
+}
+
+static void setup_windowed(void)
+{
+    memcpy(work, windowed, sizeof(work));
+}
+
+static void setup_spectrum(void)
+{
+    memcpy(work, spectrum_in, sizeof(work));
+    memset(spec, 0, sizeof(spec));
+}
+
+static bool check_s16_near(const void *ref, const void *out, double *err)
+{
+    const int16_t *r = ref;
+    const int16_t *o = out;
+    int worst = 0;
+    for (int i = 0; i < BENCH_N * 2; i++) {
+        int d = abs(r[i] - o[i]);
+        worst = d > worst ? d : worst;
+    }
+    *err = worst;
+    return worst <= 1;
+}
+
+static bool check_s16_exact(const void *ref, const void *out, double *err)
+{
+    const int16_t *r = ref;
+    const int16_t *o = out;
+    int diff = 0;
+    for (int i = 0; i < BENCH_N * 2; i++) {
+        diff += r[i] != o[i];
+    }
+    *err = diff;
+    return diff == 0;
+}
+
+static double snr_db(double signal, double noise)
+{
+    return noise > 0 ? 10 * log10(signal / noise) : 999;
+}
+
+static bool check_fft(const void *ref, const void *out, double *err)
+{
+    const int16_t *r = ref;
+    const int16_t *o = out;
+    double signal = 0, noise = 0;
+    for (int i = 0; i < BENCH_N * 2; i++) {
+        signal += (double)r[i] * r[i];
+        noise += (double)(r[i] - o[i]) * (r[i] - o[i]);
+    }
+    *err = snr_db(signal, noise);
+    return *err >= BENCH_FFT_SNR_DB;
+}
+
+static bool check_spectrum(const void *ref, const void *out, double *err)
+{
+    const float *r = ref;
+    const float *o = out;
+    double worst = 0;
+    for (int i = 0; i < BENCH_N; i++) {
+        double d = fabs(r[i] - o[i]);
+        worst = d > worst ? d : worst;
+    }
+    *err = worst;
+    return worst <= BENCH_SPECTRUM_TOL_DB;
+}
+
+// the reference FFT against a plain single precision DFT of the same input
+static bool verify_fft(double *err)
+{
+    setup_windowed();
+    ref_fft2r_sc16();
+    int bits = log2_n();
+    double signal = 0, noise = 0;
+    for (int k = 0; k < BENCH_N; k++) {
+        float re = 0, im = 0;
+        for (int t = 0; t < BENCH_N; t++) {
+            uint32_t phase = (uint32_t)(((uint64_t)((k * t) % BENCH_N) << 32) / BENCH_N);
+            float c = tone_gen_sin(phase + 0x40000000) / 32767.0f;
+            float s = tone_gen_sin(phase) / 32767.0f;
+            re += windowed[2 * t] * c + windowed[2 * t + 1] * s;
+            im += windowed[2 * t + 1] * c - windowed[2 * t] * s;
+        }
+        re /= BENCH_N;
+        im /= BENCH_N;
+        int j = bit_reverse(k, bits);
+        signal += (double)re * re + (double)im * im;
+        noise += (re - work[2 * j]) * (re - work[2 * j]) + (im - work[2 * j + 1]) * (im - work[2 * j + 1]);
+    }
+    *err = snr_db(signal, noise);
+    return *err >= BENCH_FFT_SNR_DB;
+}
+
+#if BENCH_OPUS
+static int16_t opus_pcm[BENCH_OPUS_FRAME * BENCH_OPUS_FRAMES];
+static OpusEncoder *opus_enc;
+static unsigned char opus_packet[1275];
+static int opus_frame;
+
+// the settings of OPUS_DYN_ENCODER_CFG_DEFAULT
+static OpusEncoder *opus_create(void)
+{
+    int err = OPUS_OK;
+    OpusEncoder *enc = opus_encoder_create(BENCH_OPUS_RATE, 1, OPUS_APPLICATION_AUDIO, &err);
+    if (enc) {
+        opus_encoder_ctl(enc, OPUS_SET_BITRATE(24000));
+        opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(5));
+    }
+    return enc;
+}
+
+static void setup_opus(void)
+{
+}
+
+static void lib_opus_encode(void)
+{
+    opus_encode(opus_enc, opus_pcm + opus_frame * BENCH_OPUS_FRAME, BENCH_OPUS_FRAME, opus_packet, sizeof(opus_packet));
+    opus_frame = (opus_frame + 1) % BENCH_OPUS_FRAMES;
+}
+
+// no second implementation to compare with, so check that encoding is deterministic
+static bool verify_opus(double *err)
+{
+    OpusEncoder *a = opus_create();
+    OpusEncoder *b = opus_create();
+    static unsigned char pa[1275], pb[1275];
+    int diff = 0;
+    for (int f = 0; a && b && f < BENCH_OPUS_FRAMES; f++) {
+        int na = opus_encode(a, opus_pcm + f * BENCH_OPUS_FRAME, BENCH_OPUS_FRAME, pa, sizeof(pa));
+        int nb = opus_encode(b, opus_pcm + f * BENCH_OPUS_FRAME, BENCH_OPUS_FRAME, pb, sizeof(pb));
+        diff += na <= 0 || na != nb || memcmp(pa, pb, na) != 0;
+    }
+    bool ok = a && b && diff == 0;
+    if (a) {
+        opus_encoder_destroy(a);
+    }
+    if (b) {
+        opus_encoder_destroy(b);
+    }
+    opus_enc = opus_create();
+    *err = diff;
+    return ok && opus_enc;
+}
+#endif
+
+static const bench_kernel_t kernels[] = {
+    {
+        .name = "mul_s16", .out = work, .out_size = sizeof(work),
+        .setup = setup_raw, .check = check_s16_near,
+        .variants = {
+            { "ref", ref_mul_s16 },
+#ifdef ESP_PLATFORM
+            { "ansi", ansi_mul_s16 },
+            { "opt", opt_mul_s16 },
+#endif
+        },
+    },
+    {
+        .name = "fft2r_sc16", .out = work, .out_size = sizeof(work),
+        .setup = setup_windowed, .check = check_fft, .verify = verify_fft,
+        .variants = {
+            { "ref", ref_fft2r_sc16 },
+#ifdef ESP_PLATFORM
+            { "ansi", ansi_fft2r_sc16 },
+            { "opt", opt_fft2r_sc16 },
+#endif
+        },
+    },
+    {
+        .name = "bit_rev_sc16", .out = work, .out_size = sizeof(work),
+        .setup = setup_windowed, .check = check_s16_exact,
+        .variants = {
+            { "ref", ref_bit_rev_sc16 },
+#ifdef ESP_PLATFORM
+            { "ansi", ansi_bit_rev_sc16 },
+#endif
+        },
+    },
+    {
+        .name = "spectrum", .out = spec, .out_size = sizeof(spec),
+        .setup = setup_spectrum, .check = check_spectrum,
+        .variants = {
+            { "ref", ref_spectrum },
+            { "opt", opt_spectrum },
+        },
+    },
+#if BENCH_OPUS
+    {
+        .name = "opus_encode", .out = NULL, .out_size = 0,
+        .setup = setup_opus, .verify = verify_opus,
+        .variants = {
+            { "lib", lib_opus_encode },
+        },
+    },
+#endif
+};
+
+static void prepare_inputs(void)
+{
+    // the fft.c test tone over a little pink noise, same bytes on every platform
+    tone_gen_t tone, noise;
+    tone_gen_cfg_t cfg = {
+        .type = TONE_GEN_SINE,
+        .sample_rate = 16000,
+        .channels = 1,
+        .amplitude = 12000,
+        .freq_hz = TONE_GEN_FFT_TARGET_HZ,
+    };
+    tone_gen_init(&tone, &cfg);
+    cfg.type = TONE_GEN_PINK;
+    cfg.amplitude = 1000;
+    tone_gen_init(&noise, &cfg);
+    int16_t n[BENCH_N * 2];
+    tone_gen_fill(&tone, input, BENCH_N * 2);
+    tone_gen_fill(&noise, n, BENCH_N * 2);
+    for (int i = 0; i < BENCH_N * 2; i++) {
+        input[i] += n[i];
+    }
+
+    // Hann window in Q15 like fft.c, from the integer sine: sin^2(pi i / (N - 1))
+    for (int i = 0; i < BENCH_N; i++) {
+        int32_t s = tone_gen_sin((uint32_t)(((uint64_t)i << 31) / (BENCH_N - 1)));
+        window[i] = (s * s) >> 15;
+    }
+    for (int k = 0; k < BENCH_N / 2; k++) {
+        uint32_t phase = (uint32_t)(((uint64_t)k << 32) / BENCH_N);
+        twiddle[2 * k] = tone_gen_sin(phase + 0x40000000);
+        twiddle[2 * k + 1] = -tone_gen_sin(phase);
+    }
+
+    setup_raw();
+    ref_mul_s16();
+    memcpy(windowed, work, sizeof(windowed));
+    ref_fft2r_sc16();
+    ref_bit_rev_sc16();
+    memcpy(spectrum_in, work, sizeof(spectrum_in));
+
+#if BENCH_OPUS
+    tone_gen_t speech;
+    cfg.type = TONE_GEN_BURST;
+    cfg.amplitude = 12000;
+    cfg.on_ms = 600;
+    cfg.off_ms = 200;
+    tone_gen_init(&speech, &cfg);
+    tone_gen_fill(&speech, opus_pcm, ARRAY_SIZE(opus_pcm));
+#endif
+}
+
+static uint32_t baseline_of(const char *kernel, const char *variant)
+{
+    for (int i = 0; i < ARRAY_SIZE(BENCH_BASELINE); i++) {
+        if (strcmp(BENCH_BASELINE[i].kernel, kernel) == 0 && strcmp(BENCH_BASELINE[i].variant, variant) == 0) {
+            return BENCH_BASELINE[i].value;
+        }
+    }
+    return 0;
+}
+
+static int bench_run(void)
+{
+    uint32_t results[ARRAY_SIZE(kernels)][3] = {0};
+    uint32_t gated[ARRAY_SIZE(kernels)][3] = {0};
+    int failures = 0;
+    int unchecked = 0;
+    prepare_inputs();
+    ESP_LOGI(TAG, "%s, best of %d runs in %s, regression threshold %d%%", BENCH_PLATFORM, BENCH_RUNS, BENCH_UNIT,
+             BENCH_REGRESSION);
+    int recorded = 0;
+    for (int i = 0; i < ARRAY_SIZE(BENCH_BASELINE); i++) {
+        recorded += BENCH_BASELINE[i].value != 0;
+    }
+    if (recorded == 0) {
+        ESP_LOGW(TAG, "WARNING: no %s baselines in bench_baseline.h, timings are NOT gated, only outputs are checked",
+                 BENCH_PLATFORM);
+    }
+
+    for (int k = 0; k < ARRAY_SIZE(kernels); k++) {
+        const bench_kernel_t *kn = &kernels[k];
+        if (kn->verify) {
+            double err;
+            bool ok = kn->verify(&err);
+            failures += !ok;
+            ESP_LOGI(TAG, "%-13s ref   %s (%.2f)", kn->name, ok ? "verified" : "WRONG", err);
+        }
+        for (int v = 0; v < 3 && kn->variants[v].run; v++) {
+            const bench_variant_t *var = &kn->variants[v];
+            uint32_t best = UINT32_MAX;
+            for (int r = 0; r < BENCH_RUNS; r++) {
+                kn->setup();
+                uint32_t start = bench_now();
+                var->run();
+                uint32_t t = bench_now() - start;
+                best = t < best ? t : best;
+            }
+            results[k][v] = best;
+
+            // the last run started from fresh input, so its output is comparable
+            const char *match = "-";
+            double err = 0;
+            if (v == 0 && kn->out) {
+                memcpy(ref_buf, kn->out, kn->out_size);
+            } else if (kn->check) {
+                bool ok = kn->check(ref_buf, kn->out, &err);
+                failures += !ok;
+                match = ok ? "match" : "MISMATCH";
+            }
+
+            // on the host ref is the yardstick, it is timed but has nothing to be gated against
+            bool gate = !BENCH_GATE_RATIO || (v > 0 && results[k][0]);
+            uint32_t value = best;
+            if (BENCH_GATE_RATIO) {
+                value = gate ? (uint32_t)((uint64_t)best * 100 / results[k][0]) : 0;
+            }
+            gated[k][v] = value;
+            uint32_t base = baseline_of(kn->name, var->variant);
+            const char *status = "NO BASELINE";
+            if (!gate) {
+                status = "not gated";
+            } else if (base == 0) {
+                unchecked++;
+            } else if ((uint64_t)value * 100 > (uint64_t)base * (100 + BENCH_REGRESSION)) {
+                status = "SLOWER";
+                failures++;
+            } else if ((uint64_t)value * 100 < (uint64_t)base * (100 - BENCH_REGRESSION)) {
+                status = "faster";
+            } else {
+                status = "ok";
+            }
+            float vs_ref = results[k][0] ? (float)best / results[k][0] : 0;
+            char gate_info[64] = "not gated";
+            if (gate) {
+                snprintf(gate_info, sizeof(gate_info), "%u against baseline %u %s, %s", (unsigned)value,
+                         (unsigned)base, BENCH_GATE_UNIT, status);
+            }
+            ESP_LOGI(TAG, "%-13s %-5s %10u %s, x%.2f of ref, %s, %s (%.3g)", kn->name, var->variant,
+                     (unsigned)best, BENCH_UNIT, vs_ref, gate_info, match, err);
+            printf("BENCH,%s,%s,%s,%u,%s,%u,%s,%s,%.4g\n", BENCH_PLATFORM, kn->name, var->variant, (unsigned)best,
+                   BENCH_UNIT, (unsigned)base, status, match, err);
+        }
+    }
+
+    // replacement for the table in bench_baseline.h, for when these numbers become the new baseline
+    printf("BENCH_BASELINE,%s\n", BENCH_PLATFORM);
+    for (int k = 0; k < ARRAY_SIZE(kernels); k++) {
+        for (int v = BENCH_GATE_RATIO; v < 3 && kernels[k].variants[v].run; v++) {
+            char name[20];
+            snprintf(name, sizeof(name), "\"%s\",", kernels[k].name);
+            printf("    { %-17s \"%s\",%*s%u },\n", name, kernels[k].variants[v].variant,
+                   (int)(5 - strlen(kernels[k].variants[v].variant)), "", (unsigned)gated[k][v]);
+        }
+    }
+
+    if (unchecked) {
+        // a missing baseline turns the regression check off, it must not read like a pass
+        ESP_LOGW(TAG, "WARNING: %d timings have no baseline in bench_baseline.h and were NOT checked for regressions",
+                 unchecked);
+    }
+    if (failures) {
+        ESP_LOGE(TAG, "FAIL: %d kernels wrong or slower than their baseline", failures);
+    } else {
+        ESP_LOGI(TAG, "PASS");
+    }
+    return failures;
+}
+
+#ifdef ESP_PLATFORM
+static void bench_task(void *arg)
+{
+    bench_run();
+    vTaskDelete(NULL);
+}
+
+void app_main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+    if (dsps_fft2r_init_sc16(NULL, BENCH_N) != ESP_OK) {
+        ESP_LOGE(TAG, "Not possible to initialize FFT esp-dsp from library!");
+        return;
+    }
+    // opus_encode needs the stack of an encoder element
+    xTaskCreatePinnedToCore(bench_task, "bench", 40 * 1024, NULL, 5, NULL, 0);
+}
+#else
+int main(void)
+{
+    return bench_run() ? 1 : 0;
+}
+#endif
\ No newline at end of file
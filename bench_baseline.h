@@ -0,0 +1,41 @@
+#ifndef _BENCH_BASELINE_H_
+#define _BENCH_BASELINE_H_
+
+#include <stdint.h>
+
+/* A kernel slower than its baseline by more than this fails the run. Host timings
+ * share the machine with everything else, so they get more room */
+#define BENCH_REGRESSION_PCT        (10)
+#define BENCH_REGRESSION_PCT_HOST   (25)
+
+typedef struct {
+    const char  *kernel;
+    const char  *variant;
+    uint32_t    value;          /*!< Best of BENCH_RUNS, or percent of ref on the host. 0 is not recorded: not gated */
+} bench_baseline_t;
+
+/* ESP32 CPU cycles. Not recorded yet, so the board gate is off: bench warns at the start
+ * and only checks outputs until a run on the reference board is pasted here, bench prints
+ * a replacement for this table at the end of every run */
+static const bench_baseline_t bench_baseline_device[] = {
+    { "mul_s16",        "ref",  0 },
+    { "mul_s16",        "ansi", 0 },
+    { "mul_s16",        "opt",  0 },
+    { "fft2r_sc16",     "ref",  0 },
+    { "fft2r_sc16",     "ansi", 0 },
+    { "fft2r_sc16",     "opt",  0 },
+    { "bit_rev_sc16",   "ref",  0 },
+    { "bit_rev_sc16",   "ansi", 0 },
+    { "spectrum",       "ref",  0 },
+    { "spectrum",       "opt",  0 },
+    { "opus_encode",    "lib",  0 },
+};
+
+/* Linux, time of each variant as a percentage of its ref from the same run. Absolute ns
+ * from a shared host swing by more than any usable threshold, the ratio mostly cancels
+ * that out. Median of 12 runs of the plain cc -O2 build; ref itself is not gated */
+static const bench_baseline_t bench_baseline_host[] = {
+    { "spectrum",       "opt",  79 },
+};
+
+#endif
\ No newline at end of file
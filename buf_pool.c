@@ -0,0 +1,143 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "buf_pool.h"
+
+static const char *TAG = "BUF_POOL";
+
+struct buf_pool {
+    buf_pool_buf_t      *bufs;
+    QueueHandle_t       free_q;
+    QueueHandle_t       filled_q;
+    portMUX_TYPE        lock;
+    buf_pool_stats_t    stats;
+};
+
+static bool transfer(buf_pool_handle_t pool, buf_pool_buf_t *buf, buf_pool_owner_t from, buf_pool_owner_t to)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&pool->lock);
+    if (buf >= pool->bufs && buf < pool->bufs + pool->stats.count && buf->owner == from) {
+        buf->owner = to;
+        ok = true;
+    } else {
+        pool->stats.ownership_errors++;
+    }
+    portEXIT_CRITICAL(&pool->lock);
+    if (!ok) {
+        ESP_LOGE(TAG, "Buffer %p is not in state %d", buf, from);
+    }
+    return ok;
+}
+
+buf_pool_handle_t buf_pool_create(int count, int size)
+{
+    buf_pool_handle_t pool = calloc(1, sizeof(struct buf_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    pool->stats.count = count;
+    pool->stats.free_min = count;
+    pool->bufs = calloc(count, sizeof(buf_pool_buf_t));
+    pool->free_q = xQueueCreate(count, sizeof(buf_pool_buf_t *));
+    pool->filled_q = xQueueCreate(count, sizeof(buf_pool_buf_t *));
+    if (pool->bufs == NULL || pool->free_q == NULL || pool->filled_q == NULL) {
+        goto _pool_create_fail;
+    }
+    for (int i = 0; i < count; i++) {
+        buf_pool_buf_t *buf = &pool->bufs[i];
+        buf->data = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+        if (buf->data == NULL) {
+            goto _pool_create_fail;
+        }
+        buf->size = size;
+        xQueueSend(pool->free_q, &buf, 0);
+    }
+    return pool;
+
+_pool_create_fail:
+    ESP_LOGE(TAG, "No memory for %d x %d bytes", count, size);
+    buf_pool_destroy(pool);
+    return NULL;
+}
+
+void buf_pool_destroy(buf_pool_handle_t pool)
+{
+    if (pool->bufs) {
+        for (int i = 0; i < pool->stats.count; i++) {
+            if (pool->bufs[i].owner != BUF_POOL_FREE) {
+                ESP_LOGW(TAG, "Destroying pool with buffer %d still in use", i);
+            }
+            heap_caps_free(pool->bufs[i].data);
+        }
+        free(pool->bufs);
+    }
+    if (pool->free_q) {
+        vQueueDelete(pool->free_q);
+    }
+    if (pool->filled_q) {
+        vQueueDelete(pool->filled_q);
+    }
+    free(pool);
+}
+
+buf_pool_buf_t *buf_pool_get(buf_pool_handle_t pool, TickType_t ticks)
+{
+    buf_pool_buf_t *buf = NULL;
+    if (xQueueReceive(pool->free_q, &buf, ticks) != pdTRUE) {
+        pool->stats.exhausted++;
+        return NULL;
+    }
+    int free_now = uxQueueMessagesWaiting(pool->free_q);
+    if (free_now < pool->stats.free_min) {
+        pool->stats.free_min = free_now;
+    }
+    // a buffer on the free list that is not free is still used elsewhere, it stays off the list
+    if (!transfer(pool, buf, BUF_POOL_FREE, BUF_POOL_PRODUCER)) {
+        return NULL;
+    }
+    buf->len = 0;
+    return buf;
+}
+
+esp_err_t buf_pool_submit(buf_pool_handle_t pool, buf_pool_buf_t *buf)
+{
+    if (!transfer(pool, buf, BUF_POOL_PRODUCER, BUF_POOL_QUEUED)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // cannot block, the filled queue has room for every buffer
+    xQueueSend(pool->filled_q, &buf, 0);
+    return ESP_OK;
+}
+
+buf_pool_buf_t *buf_pool_take(buf_pool_handle_t pool, TickType_t ticks)
+{
+    buf_pool_buf_t *buf = NULL;
+    if (xQueueReceive(pool->filled_q, &buf, ticks) != pdTRUE) {
+        return NULL;
+    }
+    if (!transfer(pool, buf, BUF_POOL_QUEUED, BUF_POOL_CONSUMER)) {
+        return NULL;
+    }
+    return buf;
+}
+
+esp_err_t buf_pool_release(buf_pool_handle_t pool, buf_pool_buf_t *buf)
+{
+    if (!transfer(pool, buf, BUF_POOL_CONSUMER, BUF_POOL_FREE)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xQueueSend(pool->free_q, &buf, 0);
+    return ESP_OK;
+}
+
+void buf_pool_get_stats(buf_pool_handle_t pool, buf_pool_stats_t *stats)
+{
+    portENTER_CRITICAL(&pool->lock);
+    memcpy(stats, &pool->stats, sizeof(*stats));
+    portEXIT_CRITICAL(&pool->lock);
+}
\ No newline at end of file
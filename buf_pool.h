@@ -0,0 +1,93 @@
+#ifndef _BUF_POOL_H_
+#define _BUF_POOL_H_
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Fixed-size buffers passed by reference between one producer and one consumer
+ *
+ *          A buffer is owned by exactly one side at a time: free -> producer (get) ->
+ *          consumer (submit/take) -> free (release). Out of order calls are refused and
+ *          counted instead of corrupting the pool.
+ */
+typedef struct buf_pool *buf_pool_handle_t;
+
+typedef enum {
+    BUF_POOL_FREE = 0,
+    BUF_POOL_PRODUCER,
+    BUF_POOL_QUEUED,
+    BUF_POOL_CONSUMER,
+} buf_pool_owner_t;
+
+typedef struct {
+    uint8_t             *data;
+    int                 len;        /*!< Valid bytes, set by the producer */
+    int                 size;       /*!< Capacity */
+    buf_pool_owner_t    owner;
+} buf_pool_buf_t;
+
+typedef struct {
+    int     count;                  /*!< Buffers in the pool */
+    int     free_min;               /*!< Fewest free buffers seen */
+    int     exhausted;              /*!< get calls that found no free buffer */
+    int     ownership_errors;       /*!< Calls refused because the caller did not own the buffer */
+} buf_pool_stats_t;
+
+/**
+ * @brief      Allocate a pool, buffers come from internal DMA capable memory
+ *
+ * @param      count  Number of buffers
+ * @param      size   Bytes per buffer
+ *
+ * @return     The pool, NULL when out of memory
+ */
+buf_pool_handle_t buf_pool_create(int count, int size);
+
+/**
+ * @brief      Free the pool, every buffer must have been released
+ */
+void buf_pool_destroy(buf_pool_handle_t pool);
+
+/**
+ * @brief      Producer: take a free buffer
+ *
+ * @return     The buffer, NULL if none became free within ticks or the free one was not in the free state
+ */
+buf_pool_buf_t *buf_pool_get(buf_pool_handle_t pool, TickType_t ticks);
+
+/**
+ * @brief      Producer: hand a filled buffer to the consumer
+ *
+ * @return     ESP_OK, ESP_ERR_INVALID_STATE if the producer did not own it
+ */
+esp_err_t buf_pool_submit(buf_pool_handle_t pool, buf_pool_buf_t *buf);
+
+/**
+ * @brief      Consumer: wait for the next filled buffer, in submit order
+ *
+ * @return     The buffer, NULL on timeout or if the queued one was not in the queued state
+ */
+buf_pool_buf_t *buf_pool_take(buf_pool_handle_t pool, TickType_t ticks);
+
+/**
+ * @brief      Consumer: give a buffer back once its data has been written
+ *
+ * @return     ESP_OK, ESP_ERR_INVALID_STATE if the consumer did not own it
+ */
+esp_err_t buf_pool_release(buf_pool_handle_t pool, buf_pool_buf_t *buf);
+
+/**
+ * @brief      Read the pool counters
+ */
+void buf_pool_get_stats(buf_pool_handle_t pool, buf_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+/* Host check of the buf_pool ownership rules: free -> producer -> queued -> consumer -> free,
+ * every out of order call refused and counted, buffers come back in submit order.
+ *
+ *     cc -O2 -Ihost -I. -o buf_pool_test buf_pool_test.c buf_pool.c
+ *
+ * host/ holds single task stand-ins for the FreeRTOS queue and the ESP-IDF headers. Every
+ * mismatch is printed, the run exits with 1 if there was any.
+ */
+#ifndef ESP_PLATFORM
+#include <stdio.h>
+
+#include "buf_pool.h"
+
+#define TEST_COUNT  (3)
+#define TEST_SIZE   (64)
+
+static int failures;
+
+#define CHECK(cond, ...) do {                   \
+    if (!(cond)) {                              \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        failures++;                             \
+    }                                           \
+} while (0)
+
+static int ownership_errors(buf_pool_handle_t pool)
+{
+    buf_pool_stats_t st;
+    buf_pool_get_stats(pool, &st);
+    return st.ownership_errors;
+}
+
+static void check_cycle(void)
+{
+    buf_pool_handle_t pool = buf_pool_create(TEST_COUNT, TEST_SIZE);
+    if (pool == NULL) {
+        printf("FAIL: no memory\n");
+        failures++;
+        return;
+    }
+    buf_pool_buf_t *b[TEST_COUNT];
+    for (int i = 0; i < TEST_COUNT; i++) {
+        b[i] = buf_pool_get(pool, 0);
+        CHECK(b[i] && b[i]->owner == BUF_POOL_PRODUCER && b[i]->size == TEST_SIZE && b[i]->len == 0,
+              "get %d", i);
+        for (int j = 0; j < i; j++) {
+            CHECK(b[i] != b[j], "get %d returned buffer %d again", i, j);
+        }
+    }
+    CHECK(buf_pool_get(pool, 0) == NULL, "get from an empty pool");
+    CHECK(buf_pool_take(pool, 0) == NULL, "take before any submit");
+
+    buf_pool_stats_t st;
+    buf_pool_get_stats(pool, &st);
+    CHECK(st.count == TEST_COUNT && st.free_min == 0 && st.exhausted == 1 && st.ownership_errors == 0,
+          "stats after emptying: count %d free_min %d exhausted %d errors %d", st.count, st.free_min,
+          st.exhausted, st.ownership_errors);
+
+    // the producer cannot release, the consumer side has not had it
+    CHECK(buf_pool_release(pool, b[0]) == ESP_ERR_INVALID_STATE, "release by the producer");
+    CHECK(b[0]->owner == BUF_POOL_PRODUCER, "refused release changed the owner");
+
+    b[1]->len = 11;
+    b[0]->len = 10;
+    CHECK(buf_pool_submit(pool, b[1]) == ESP_OK, "submit 1");
+    CHECK(buf_pool_submit(pool, b[0]) == ESP_OK, "submit 0");
+    CHECK(buf_pool_submit(pool, b[0]) == ESP_ERR_INVALID_STATE, "second submit of the same buffer");
+    CHECK(buf_pool_release(pool, b[1]) == ESP_ERR_INVALID_STATE, "release of a queued buffer");
+
+    buf_pool_buf_t *t = buf_pool_take(pool, 0);
+    CHECK(t == b[1] && t->owner == BUF_POOL_CONSUMER && t->len == 11, "first take is not the first submit");
+    CHECK(buf_pool_submit(pool, t) == ESP_ERR_INVALID_STATE, "submit of a buffer the consumer holds");
+    CHECK(buf_pool_release(pool, t) == ESP_OK, "release 1");
+    CHECK(buf_pool_release(pool, t) == ESP_ERR_INVALID_STATE, "second release of the same buffer");
+    t = buf_pool_take(pool, 0);
+    CHECK(t == b[0] && t->len == 10, "second take is not the second submit");
+    CHECK(buf_pool_release(pool, t) == ESP_OK, "release 0");
+
+    // a pointer that is not one of the pool's buffers
+    buf_pool_buf_t stray = { .owner = BUF_POOL_PRODUCER };
+    CHECK(buf_pool_submit(pool, &stray) == ESP_ERR_INVALID_STATE, "submit of a foreign buffer");
+
+    // released buffers come back emptied, in release order
+    t = buf_pool_get(pool, 0);
+    CHECK(t == b[1] && t->len == 0, "get after release");
+    CHECK(buf_pool_submit(pool, t) == ESP_OK && buf_pool_take(pool, 0) == t && buf_pool_release(pool, t) == ESP_OK,
+          "full cycle after reuse");
+
+    // a buffer on the free list that something else still writes to is not handed out
+    t = buf_pool_get(pool, 0);
+    CHECK(t == b[0], "get of the next free buffer");
+    buf_pool_submit(pool, t);
+    buf_pool_take(pool, 0);
+    buf_pool_release(pool, t);
+    // b[1] is next on the free list
+    b[1]->owner = BUF_POOL_CONSUMER;
+    int before = ownership_errors(pool);
+    CHECK(buf_pool_get(pool, 0) == NULL, "a buffer not in the free state was handed out");
+    CHECK(ownership_errors(pool) == before + 1, "the refused get was not counted");
+    b[1]->owner = BUF_POOL_FREE;
+
+    buf_pool_release(pool, b[2]);
+    CHECK(ownership_errors(pool) == 8, "%d ownership errors, expected 8", ownership_errors(pool));
+    b[2]->owner = BUF_POOL_FREE;
+    buf_pool_destroy(pool);
+}
+
+int main(void)
+{
+    check_cycle();
+    printf("%s: %d failures\n", failures ? "FAIL" : "PASS", failures);
+    return failures ? 1 : 0;
+}
+#endif
\ No newline at end of file
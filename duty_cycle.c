@@ -0,0 +1,94 @@
+#include <string.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_random.h"
+#include "esp_attr.h"
+#include "esp_wifi.h"
+
+#include "energy_model.h"
+#include "fast_boot.h"
+#include "duty_cycle.h"
+
+static const char *TAG = "DUTY_CYCLE";
+
+#define DUTY_CYCLE_MAGIC (0x44555459)
+
+static RTC_DATA_ATTR duty_cycle_state_t state;
+static bool warm;
+
+duty_cycle_state_t *duty_cycle_begin(void)
+{
+    warm = esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER && state.magic == DUTY_CYCLE_MAGIC;
+    if (!warm) {
+        memset(&state, 0, sizeof(state));
+        state.magic = DUTY_CYCLE_MAGIC;
+        state.ogg_serial = esp_random();
+    }
+    return &state;
+}
+
+bool duty_cycle_is_warm(void)
+{
+    return warm;
+}
+
+void duty_cycle_apply_wifi(wifi_config_t *cfg)
+{
+    if (!warm || state.channel == 0) {
+        return;
+    }
+    cfg->sta.channel = state.channel;
+    cfg->sta.bssid_set = true;
+    memcpy(cfg->sta.bssid, state.bssid, sizeof(state.bssid));
+}
+
+void duty_cycle_save_wifi(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        memcpy(state.bssid, ap.bssid, sizeof(state.bssid));
+        state.channel = ap.primary;
+    } else {
+        state.channel = 0;
+    }
+}
+
+void duty_cycle_sleep(const duty_cycle_cfg_t *cfg, const char *scenario)
+{
+    energy_counters_t c;
+    energy_model_get_counters(&c);
+    energy_coeffs_t k = ENERGY_COEFFS_DEFAULT();
+    energy_estimate_t e;
+    energy_model_estimate(&c, &k, &e);
+
+    // esp_timer restarts on every wake, the bootloader is not in here
+    int64_t awake_us = esp_timer_get_time();
+    int64_t outside_us = awake_us > c.wall_us ? awake_us - c.wall_us : 0;
+    float awake_mj = e.total_mj + outside_us / 1e6f * cfg->boot_mw;
+    int64_t sleep_us = cfg->sleep_seconds * 1000000LL;
+    float sleep_mj = sleep_us / 1e6f * cfg->sleep_mw;
+
+    state.cycle++;
+    state.awake_us += awake_us;
+    state.sleep_us += sleep_us;
+    state.energy_mj += awake_mj + sleep_mj;
+
+    float cycle_s = (awake_us + sleep_us) / 1e6f;
+    float total_s = (state.awake_us + state.sleep_us) / 1e6f;
+    float cycle_ma = (awake_mj + sleep_mj) / cycle_s / cfg->supply_v;
+    float avg_ma = state.energy_mj / total_s / cfg->supply_v;
+    int64_t capture_us = fast_boot_get(FAST_BOOT_FIRST_SAMPLE);
+    ESP_LOGI(TAG, "%s: cycle %d (%s), wake to capture %.1f ms, awake %.1f ms, %.1f mJ awake",
+             scenario, state.cycle, warm ? "warm" : "cold", capture_us / 1000.0f, awake_us / 1000.0f, awake_mj);
+    ESP_LOGI(TAG, "%s: %.3f mA this cycle, %.3f mA average over %d cycles, sleeping %d s",
+             scenario, cycle_ma, avg_ma, state.cycle, cfg->sleep_seconds);
+    printf("DUTY,%s,%d,%d,%lld,%lld,%.3f,%.4f,%.4f\n", scenario, state.cycle, warm, capture_us, awake_us,
+           awake_mj, cycle_ma, avg_ma);
+    fflush(stdout);
+
+    esp_sleep_enable_timer_wakeup(sleep_us);
+    esp_deep_sleep_start();
+}
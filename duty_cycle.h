@@ -0,0 +1,83 @@
+#ifndef _DUTY_CYCLE_H_
+#define _DUTY_CYCLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_wifi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   State carried across deep sleep in RTC memory
+ *
+ *          Lost on power loss or reset, duty_cycle_begin then reports a cold start and
+ *          the scenario starts a new recording.
+ */
+typedef struct {
+    uint32_t    magic;
+    int         cycle;              /*!< Completed cycles since the cold start */
+    uint32_t    ogg_serial;         /*!< Stream being appended to, opus_wifi adds cycle for one link per wake */
+    uint32_t    ogg_next_seq;       /*!< Sequence number for the next page */
+    int64_t     ogg_granule;        /*!< Granule position reached so far */
+    int64_t     file_size;          /*!< Recording size after the last cycle, checked before appending */
+    int         bitrate;            /*!< Encoder bitrate the last cycle settled on, 0 if unknown */
+    uint8_t     bssid[6];           /*!< Access point of the last cycle */
+    uint8_t     channel;            /*!< Its channel, 0 when nothing is remembered */
+    int64_t     awake_us;           /*!< Summed over all cycles */
+    int64_t     sleep_us;
+    float       energy_mj;          /*!< Estimate summed over all cycles, sleep included */
+} duty_cycle_state_t;
+
+typedef struct {
+    int     sleep_seconds;          /*!< Deep sleep between recording windows */
+    float   sleep_mw;               /*!< Board power in deep sleep */
+    float   boot_mw;                /*!< Power while awake outside the energy model window, boot and teardown */
+    float   supply_v;               /*!< For the current figures */
+} duty_cycle_cfg_t;
+
+/* The ESP32 itself draws ~10 uA in timer-wakeup deep sleep, the default adds codec,
+ * sdcard and regulator standby. Measure the board and replace it */
+#define DUTY_CYCLE_CFG_DEFAULT() {  \
+    .sleep_seconds = 60,            \
+    .sleep_mw = 1.0f,               \
+    .boot_mw = 120.0f,              \
+    .supply_v = 3.3f,               \
+}
+
+/**
+ * @brief      Call first in app_main
+ *
+ * @return     The RTC state, reset on a cold start
+ */
+duty_cycle_state_t *duty_cycle_begin(void);
+
+/**
+ * @brief      True when woken by the sleep timer with valid state
+ */
+bool duty_cycle_is_warm(void);
+
+/**
+ * @brief      Point the station at the remembered access point and channel so association skips the scan
+ */
+void duty_cycle_apply_wifi(wifi_config_t *cfg);
+
+/**
+ * @brief      Remember the current access point, or forget it if not associated so the next wake scans again
+ */
+void duty_cycle_save_wifi(void);
+
+/**
+ * @brief      Log the cycle and enter deep sleep, does not return
+ *
+ *             Call after energy_model_report, the awake energy is that window plus the
+ *             time outside it at boot_mw. Prints a DUTY,... CSV line.
+ */
+void duty_cycle_sleep(const duty_cycle_cfg_t *cfg, const char *scenario);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
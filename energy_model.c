@@ -0,0 +1,247 @@
+#include <string.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_pm.h"
+#include "esp_private/esp_clk.h"
+#include "sdkconfig.h"
+
+#include "energy_model.h"
+
+static const char *TAG = "ENERGY";
+
+// Radio model for the on time estimate, the driver does not report it
+#define RADIO_PHY_MBPS (54)
+#define RADIO_MSS (CONFIG_LWIP_TCP_MSS)
+#define RADIO_PER_PACKET_US (200)
+#define RADIO_BEACON_US (102400)
+#define RADIO_WAKE_US (3000)
+#define RADIO_DTIM (1)
+
+static energy_counters_t counters;
+static int64_t start_us;
+static int64_t start_idle_us;
+static bool wifi_used;
+
+/* Run time counters are in us with CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER,
+ * which is the default once run time stats are enabled. Unless
+ * CONFIG_FREERTOS_RUN_TIME_COUNTER_TYPE_U64 is set they are 32 bits wide and wrap after
+ * 71.6 minutes, so a timer samples every task well inside that and sums the deltas */
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY && !CONFIG_FREERTOS_RUN_TIME_COUNTER_TYPE_U64
+#define RUNTIME_WIDEN (1)
+#define RUNTIME_SAMPLE_US (60 * 1000000LL)
+#define RUNTIME_MAX_TASKS (48)
+
+typedef struct {
+    TaskHandle_t    task;
+    char            name[configMAX_TASK_NAME_LEN];
+    uint32_t        last;
+    int64_t         total;
+} runtime_acc_t;
+
+static runtime_acc_t runtime_acc[RUNTIME_MAX_TASKS];
+static runtime_acc_t runtime_next[RUNTIME_MAX_TASKS];
+static int runtime_num;
+static TaskStatus_t runtime_snap[RUNTIME_MAX_TASKS];
+static esp_timer_handle_t runtime_timer;
+static portMUX_TYPE runtime_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// only ever runs in the esp_timer task after the first call, readers take the lock
+static void runtime_sample(void *arg)
+{
+    UBaseType_t n = uxTaskGetSystemState(runtime_snap, RUNTIME_MAX_TASKS, NULL);
+    if (n == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, run times may wrap", RUNTIME_MAX_TASKS);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        const TaskStatus_t *t = &runtime_snap[i];
+        runtime_acc_t *a = &runtime_next[i];
+        a->task = t->xHandle;
+        a->last = t->ulRunTimeCounter;
+        a->total = t->ulRunTimeCounter;
+        strlcpy(a->name, t->pcTaskName, sizeof(a->name));
+        // a handle can be reused by a new task, the name tells them apart
+        for (int k = 0; k < runtime_num; k++) {
+            if (runtime_acc[k].task == a->task && strcmp(runtime_acc[k].name, a->name) == 0) {
+                a->total = runtime_acc[k].total + (uint32_t)(a->last - runtime_acc[k].last);
+                break;
+            }
+        }
+    }
+    portENTER_CRITICAL(&runtime_lock);
+    memcpy(runtime_acc, runtime_next, n * sizeof(runtime_acc_t));
+    runtime_num = n;
+    portEXIT_CRITICAL(&runtime_lock);
+}
+
+static void runtime_widen_start(void)
+{
+    if (runtime_timer != NULL) {
+        return;
+    }
+    const esp_timer_create_args_t args = {
+        .callback = runtime_sample,
+        .name = "energy_rt",
+    };
+    runtime_sample(NULL);
+    if (esp_timer_create(&args, &runtime_timer) != ESP_OK
+        || esp_timer_start_periodic(runtime_timer, RUNTIME_SAMPLE_US) != ESP_OK) {
+        ESP_LOGW(TAG, "No run time sampling timer, task times wrap after 71 minutes");
+    }
+}
+#else
+#define RUNTIME_WIDEN (0)
+#endif
+
+static int64_t task_runtime_us(TaskHandle_t task)
+{
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY
+    if (task == NULL) {
+        return 0;
+    }
+    TaskStatus_t status;
+    vTaskGetInfo(task, &status, pdFALSE, eRunning);
+#if RUNTIME_WIDEN
+    int64_t runtime = status.ulRunTimeCounter;
+    portENTER_CRITICAL(&runtime_lock);
+    for (int k = 0; k < runtime_num; k++) {
+        if (runtime_acc[k].task == task && strcmp(runtime_acc[k].name, status.pcTaskName) == 0) {
+            runtime = runtime_acc[k].total + (uint32_t)(status.ulRunTimeCounter - runtime_acc[k].last);
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&runtime_lock);
+    return runtime;
+#else
+    return status.ulRunTimeCounter;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static int64_t idle_runtime_us(void)
+{
+    int64_t idle = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        idle += task_runtime_us(xTaskGetIdleTaskHandleForCore(core));
+    }
+    return idle;
+}
+
+int64_t energy_model_task_runtime_us(const char *name)
+{
+    return task_runtime_us(xTaskGetHandle(name));
+}
+
+void energy_model_start(void)
+{
+#if !(CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_USE_TRACE_FACILITY)
+    ESP_LOGW(TAG, "FreeRTOS run time stats are disabled, CPU time will read as idle");
+#endif
+    memset(&counters, 0, sizeof(counters));
+    wifi_used = false;
+    counters.cores = portNUM_PROCESSORS;
+    counters.cpu_mhz = esp_clk_cpu_freq() / 1000000;
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_cfg;
+    if (esp_pm_get_configuration(&pm_cfg) == ESP_OK) {
+        counters.light_sleep = pm_cfg.light_sleep_enable;
+    }
+#endif
+#if RUNTIME_WIDEN
+    runtime_widen_start();
+#endif
+    start_idle_us = idle_runtime_us();
+    start_us = esp_timer_get_time();
+}
+
+void energy_model_add_sd(int64_t bytes, int64_t busy_us)
+{
+    counters.sd_bytes += bytes;
+    counters.sd_busy_us += busy_us;
+}
+
+void energy_model_add_wifi(int64_t tx_bytes)
+{
+    counters.wifi_tx_bytes += tx_bytes;
+    wifi_used = true;
+}
+
+int64_t energy_model_radio_tx_us(int64_t tx_bytes)
+{
+    int64_t packets = (tx_bytes + RADIO_MSS - 1) / RADIO_MSS;
+    return tx_bytes * 8 / RADIO_PHY_MBPS + packets * RADIO_PER_PACKET_US;
+}
+
+int64_t energy_model_radio_us(wifi_ps_type_t ps, int listen_interval, int64_t tx_bytes, int64_t awake_us, int64_t wall_us)
+{
+    if (ps == WIFI_PS_NONE) {
+        return wall_us;
+    }
+    int interval = ps == WIFI_PS_MAX_MODEM && listen_interval > 0 ? listen_interval : RADIO_DTIM;
+    int64_t active = energy_model_radio_tx_us(tx_bytes) + awake_us
+                     + wall_us / (RADIO_BEACON_US * interval) * RADIO_WAKE_US;
+    return active < wall_us ? active : wall_us;
+}
+
+static int64_t wifi_radio_us(int64_t tx_bytes, int64_t wall_us)
+{
+    wifi_ps_type_t ps = WIFI_PS_NONE;
+    wifi_config_t sta_cfg = {0};
+    if (esp_wifi_get_ps(&ps) != ESP_OK) {
+        return 0;
+    }
+    esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
+    return energy_model_radio_us(ps, sta_cfg.sta.listen_interval, tx_bytes, 0, wall_us);
+}
+
+void energy_model_estimate(const energy_counters_t *c, const energy_coeffs_t *k, energy_estimate_t *out)
+{
+    float busy_s = c->busy_us / 1e6f;
+    float idle_s = c->idle_us / 1e6f;
+    out->base_mj = c->wall_us / 1e6f * k->base_mw;
+    out->cpu_mj = busy_s * (k->cpu_active_mw + k->cpu_mw_per_mhz * c->cpu_mhz);
+    out->idle_mj = idle_s * (c->light_sleep ? k->light_sleep_mw : k->cpu_idle_mw);
+    out->sd_mj = c->sd_bytes * k->sd_nj_per_byte / 1e6f + c->sd_busy_us / 1e6f * k->sd_busy_mw;
+    out->wifi_mj = c->wifi_tx_bytes * k->wifi_tx_nj_per_byte / 1e6f + c->wifi_radio_us / 1e6f * k->wifi_radio_mw;
+    out->total_mj = out->base_mj + out->cpu_mj + out->idle_mj + out->sd_mj + out->wifi_mj;
+}
+
+void energy_model_get_counters(energy_counters_t *c)
+{
+    memcpy(c, &counters, sizeof(*c));
+}
+
+void energy_model_report(const char *scenario, int recorded_seconds)
+{
+    counters.wall_us = esp_timer_get_time() - start_us;
+    counters.idle_us = idle_runtime_us() - start_idle_us;
+    counters.busy_us = counters.wall_us * counters.cores - counters.idle_us;
+    if (counters.busy_us < 0) {
+        counters.busy_us = 0;
+    }
+    if (wifi_used) {
+        counters.wifi_radio_us = wifi_radio_us(counters.wifi_tx_bytes, counters.wall_us);
+    }
+
+    energy_coeffs_t coeffs = ENERGY_COEFFS_DEFAULT();
+    energy_estimate_t e;
+    energy_model_estimate(&counters, &coeffs, &e);
+    float per_s = recorded_seconds > 0 ? 1.0f / recorded_seconds : 0;
+    ESP_LOGI(TAG, "%s: %.1f mJ per recorded second (base %.1f, cpu %.1f, idle %.1f, sd %.1f, wifi %.1f)",
+             scenario, e.total_mj * per_s, e.base_mj * per_s, e.cpu_mj * per_s, e.idle_mj * per_s,
+             e.sd_mj * per_s, e.wifi_mj * per_s);
+    ESP_LOGI(TAG, "%s: cpu %d MHz, busy %lld ms, idle %lld ms%s, sd %lld bytes / %lld ms, wifi %lld bytes / %lld ms radio",
+             scenario, counters.cpu_mhz, counters.busy_us / 1000, counters.idle_us / 1000,
+             counters.light_sleep ? " (light sleep)" : "", counters.sd_bytes, counters.sd_busy_us / 1000,
+             counters.wifi_tx_bytes, counters.wifi_radio_us / 1000);
+    // append the measured mJ from the power meter to this line for tools/energy_fit.py
+    printf("ENERGY,%s,%d,%lld,%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%.3f\n", scenario, recorded_seconds,
+           counters.wall_us, counters.cpu_mhz, counters.light_sleep, counters.busy_us, counters.idle_us,
+           counters.sd_bytes, counters.sd_busy_us, counters.wifi_tx_bytes, counters.wifi_radio_us, e.total_mj);
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#ifndef _ENERGY_MODEL_H_
+#define _ENERGY_MODEL_H_
+
+#include <stdint.h>
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Per-component power coefficients
+ *
+ *          The defaults are datasheet-level figures for an ESP32 on the LyraT. Replace them
+ *          with the output of tools/energy_fit.py once power meter runs have been logged.
+ */
+typedef struct {
+    float   base_mw;            /*!< Always on: regulators, codec, leakage */
+    float   cpu_active_mw;      /*!< One busy core, frequency independent part */
+    float   cpu_mw_per_mhz;     /*!< One busy core, per MHz of clock */
+    float   cpu_idle_mw;        /*!< One idle core, clock running */
+    float   light_sleep_mw;     /*!< One idle core in automatic light sleep */
+    float   sd_nj_per_byte;     /*!< SD transfer energy */
+    float   sd_busy_mw;         /*!< SD card while a write is in flight */
+    float   wifi_tx_nj_per_byte;/*!< Wi-Fi energy per payload byte sent */
+    float   wifi_radio_mw;      /*!< Wi-Fi radio while awake */
+} energy_coeffs_t;
+
+#define ENERGY_COEFFS_DEFAULT() {   \
+    .base_mw = 60.0f,               \
+    .cpu_active_mw = 30.0f,         \
+    .cpu_mw_per_mhz = 0.25f,        \
+    .cpu_idle_mw = 25.0f,           \
+    .light_sleep_mw = 2.5f,         \
+    .sd_nj_per_byte = 40.0f,        \
+    .sd_busy_mw = 100.0f,           \
+    .wifi_tx_nj_per_byte = 120.0f,  \
+    .wifi_radio_mw = 330.0f,        \
+}
+
+/**
+ * @brief   Counters collected between energy_model_start and energy_model_report
+ */
+typedef struct {
+    int64_t wall_us;            /*!< Elapsed time */
+    int     cpu_mhz;            /*!< CPU clock */
+    int     cores;              /*!< Number of cores */
+    int     light_sleep;        /*!< 1 if idle time was spent in automatic light sleep */
+    int64_t busy_us;            /*!< Busy time summed over cores */
+    int64_t idle_us;            /*!< Idle time summed over cores */
+    int64_t sd_bytes;           /*!< Bytes written to or read from the sdcard */
+    int64_t sd_busy_us;         /*!< Time the sdcard writer was busy */
+    int64_t wifi_tx_bytes;      /*!< Bytes sent over Wi-Fi */
+    int64_t wifi_radio_us;      /*!< Estimated radio on time */
+} energy_counters_t;
+
+/**
+ * @brief   Energy split by subsystem, in mJ
+ */
+typedef struct {
+    float   base_mj;
+    float   cpu_mj;
+    float   idle_mj;
+    float   sd_mj;
+    float   wifi_mj;
+    float   total_mj;
+} energy_estimate_t;
+
+/**
+ * @brief      Reset the counters and remember the idle time and clock at this point
+ */
+void energy_model_start(void);
+
+/**
+ * @brief      Account for sdcard traffic
+ *
+ * @param      bytes    Bytes transferred
+ * @param      busy_us  Time the writer spent on them, 0 if unknown
+ */
+void energy_model_add_sd(int64_t bytes, int64_t busy_us);
+
+/**
+ * @brief      Account for Wi-Fi traffic, the radio on time is estimated from the power save mode
+ *
+ * @param      tx_bytes  Bytes sent
+ */
+void energy_model_add_wifi(int64_t tx_bytes);
+
+/**
+ * @brief      On air time of a transfer, the data part of energy_model_radio_us
+ *
+ * @param      tx_bytes  Payload bytes sent
+ *
+ * @return     Time in us
+ */
+int64_t energy_model_radio_tx_us(int64_t tx_bytes);
+
+/**
+ * @brief      Estimate how long the Wi-Fi radio was awake, the driver does not report it
+ *
+ * @param      ps               Power save mode
+ * @param      listen_interval  Beacons between wakes in WIFI_PS_MAX_MODEM
+ * @param      tx_bytes         Payload bytes sent
+ * @param      awake_us         Time the radio was held awake besides sending, e.g. blocked in send()
+ * @param      wall_us          Length of the window
+ *
+ * @return     Radio on time in us, at most wall_us
+ */
+int64_t energy_model_radio_us(wifi_ps_type_t ps, int listen_interval, int64_t tx_bytes, int64_t awake_us, int64_t wall_us);
+
+/**
+ * @brief      CPU time a task has used so far
+ *
+ * @param      name  Task name, audio elements use their registered tag
+ *
+ * @return     Run time in us, past the 32-bit counter wrap once energy_model_start has run.
+ *             0 if run time stats are disabled or the task does not exist
+ */
+int64_t energy_model_task_runtime_us(const char *name);
+
+/**
+ * @brief      Turn counters into an estimate
+ *
+ * @param      counters  Counters to use
+ * @param      coeffs    Coefficients to use
+ * @param      out       The estimate
+ */
+void energy_model_estimate(const energy_counters_t *counters, const energy_coeffs_t *coeffs, energy_estimate_t *out);
+
+/**
+ * @brief      Close the measurement window and log mJ per recorded second by subsystem,
+ *             plus an ENERGY CSV line for tools/energy_fit.py
+ *
+ * @param      scenario          Name printed in the report
+ * @param      recorded_seconds  Seconds of audio captured in the window
+ */
+void energy_model_report(const char *scenario, int recorded_seconds);
+
+/**
+ * @brief      Counters of the window closed by the last energy_model_report
+ */
+void energy_model_get_counters(energy_counters_t *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,254 @@
+#include <string.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "board.h"
+#include "periph_sdcard.h"
+#include "periph_wifi.h"
+#include "fast_boot.h"
+
+static const char *TAG = "FAST_BOOT";
+
+#define FAST_BOOT_MAX_WATCH (4)
+#define FAST_BOOT_STEP_STACK (4 * 1024)
+#define FAST_BOOT_STEP_PRIO (10)
+#define FAST_BOOT_SD_TIMEOUT_MS (2500)
+
+static const char *event_names[FAST_BOOT_EVENT_MAX] = {
+    "app_main",
+    "codec_ready",
+    "pipeline_ready",
+    "sd_mounted",
+    "wifi_connected",
+    "first_sample",
+    "first_write",
+    "first_send",
+};
+
+struct fast_boot_step {
+    fast_boot_step_fn_t fn;
+    void                *arg;
+    SemaphoreHandle_t   done;           /*!< NULL when the step ran inline */
+    esp_err_t           result;
+};
+
+typedef struct {
+    bool                (*ready)(void *arg);
+    void                *arg;
+    fast_boot_event_t   event;
+} fast_boot_watch_t;
+
+static int64_t marks[FAST_BOOT_EVENT_MAX];
+static fast_boot_watch_t watches[FAST_BOOT_MAX_WATCH];
+static int watch_count;
+static bool watching;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+void fast_boot_mark_at(fast_boot_event_t event, int64_t time_us)
+{
+    if (event >= FAST_BOOT_EVENT_MAX || time_us == 0) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    if (marks[event] == 0) {
+        marks[event] = time_us;
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+void fast_boot_mark(fast_boot_event_t event)
+{
+    fast_boot_mark_at(event, esp_timer_get_time());
+}
+
+int64_t fast_boot_get(fast_boot_event_t event)
+{
+    return event < FAST_BOOT_EVENT_MAX ? marks[event] : 0;
+}
+
+static void fast_boot_watch_task(void *arg)
+{
+    while (1) {
+        int pending = 0;
+        portENTER_CRITICAL(&lock);
+        int count = watch_count;
+        portEXIT_CRITICAL(&lock);
+        for (int i = 0; i < count; i++) {
+            if (marks[watches[i].event]) {
+                continue;
+            }
+            if (watches[i].ready(watches[i].arg)) {
+                fast_boot_mark(watches[i].event);
+            } else {
+                pending++;
+            }
+        }
+        if (pending == 0) {
+            // only stop if nothing was added while we looked
+            bool done = false;
+            portENTER_CRITICAL(&lock);
+            if (watch_count == count) {
+                watch_count = 0;
+                watching = false;
+                done = true;
+            }
+            portEXIT_CRITICAL(&lock);
+            if (done) {
+                break;
+            }
+            continue;
+        }
+        vTaskDelay(1);
+    }
+    vTaskDelete(NULL);
+}
+
+static bool element_moved(void *arg)
+{
+    audio_element_info_t info;
+    audio_element_getinfo((audio_element_handle_t)arg, &info);
+    return info.byte_pos > 0;
+}
+
+static bool wifi_connected(void *arg)
+{
+    return periph_wifi_is_connected((esp_periph_handle_t)arg) == PERIPH_WIFI_CONNECTED;
+}
+
+static void fast_boot_add_watch(bool (*ready)(void *arg), void *arg, fast_boot_event_t event)
+{
+    bool start = false;
+    portENTER_CRITICAL(&lock);
+    if (watch_count < FAST_BOOT_MAX_WATCH) {
+        watches[watch_count].ready = ready;
+        watches[watch_count].arg = arg;
+        watches[watch_count].event = event;
+        watch_count++;
+        start = !watching;
+        watching = true;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (start) {
+        xTaskCreate(fast_boot_watch_task, "boot_watch", 2048, NULL, 1, NULL);
+    }
+}
+
+void fast_boot_watch(audio_element_handle_t el, fast_boot_event_t event)
+{
+    fast_boot_add_watch(element_moved, el, event);
+}
+
+void fast_boot_watch_wifi(esp_periph_handle_t wifi_handle)
+{
+    fast_boot_add_watch(wifi_connected, wifi_handle, FAST_BOOT_WIFI_CONNECTED);
+}
+
+static void fast_boot_step_task(void *arg)
+{
+    struct fast_boot_step *step = (struct fast_boot_step *)arg;
+    step->result = step->fn(step->arg);
+    xSemaphoreGive(step->done);
+    vTaskDelete(NULL);
+}
+
+fast_boot_step_handle_t fast_boot_step_start(const char *name, fast_boot_step_fn_t fn, void *arg)
+{
+    struct fast_boot_step *step = calloc(1, sizeof(struct fast_boot_step));
+    if (step == NULL) {
+        ESP_LOGE(TAG, "No memory for %s", name);
+        return NULL;
+    }
+    step->fn = fn;
+    step->arg = arg;
+    step->done = xSemaphoreCreateBinary();
+    if (step->done == NULL
+        || xTaskCreate(fast_boot_step_task, name, FAST_BOOT_STEP_STACK, step, FAST_BOOT_STEP_PRIO, NULL) != pdPASS) {
+        ESP_LOGW(TAG, "Running %s inline", name);
+        if (step->done) {
+            vSemaphoreDelete(step->done);
+            step->done = NULL;
+        }
+        // the handle stays, so the caller still gets the result from fast_boot_step_wait
+        step->result = fn(arg);
+    }
+    return step;
+}
+
+esp_err_t fast_boot_step_wait(fast_boot_step_handle_t step)
+{
+    if (step == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (step->done) {
+        xSemaphoreTake(step->done, portMAX_DELAY);
+        vSemaphoreDelete(step->done);
+    }
+    esp_err_t ret = step->result;
+    free(step);
+    return ret;
+}
+
+esp_err_t fast_boot_sdcard_mount(esp_periph_set_handle_t set, int timeout_ms)
+{
+    periph_sdcard_cfg_t sdcard_cfg = {
+        .root = "/sdcard",
+        .card_detect_pin = get_sdcard_intr_gpio(),
+        .mode = SD_MODE_1_LINE,
+    };
+    esp_periph_handle_t sdcard_handle = periph_sdcard_init(&sdcard_cfg);
+    if (esp_periph_start(set, sdcard_handle) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    int64_t deadline = esp_timer_get_time() + timeout_ms * 1000LL;
+    while (!periph_sdcard_is_mounted(sdcard_handle)) {
+        if (esp_timer_get_time() > deadline) {
+            ESP_LOGE(TAG, "Sdcard mount failed");
+            return ESP_FAIL;
+        }
+        vTaskDelay(1);
+    }
+    fast_boot_mark(FAST_BOOT_SD_MOUNTED);
+    return ESP_OK;
+}
+
+esp_err_t fast_boot_sdcard_step(void *set)
+{
+    return fast_boot_sdcard_mount((esp_periph_set_handle_t)set, FAST_BOOT_SD_TIMEOUT_MS);
+}
+
+void fast_boot_report(const char *scenario)
+{
+    int order[FAST_BOOT_EVENT_MAX];
+    int n = 0;
+    for (int i = 0; i < FAST_BOOT_EVENT_MAX; i++) {
+        if (marks[i] == 0) {
+            continue;
+        }
+        int j = n++;
+        while (j > 0 && marks[order[j - 1]] > marks[i]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+    int64_t prev = 0;
+    for (int k = 0; k < n; k++) {
+        int64_t t = marks[order[k]];
+        ESP_LOGI(TAG, "%s: %-15s %7.1f ms (+%.1f)", scenario, event_names[order[k]], t / 1000.0f, (t - prev) / 1000.0f);
+        prev = t;
+    }
+    // one column per event in enum order, empty when it never happened
+    printf("BOOT,%s", scenario);
+    for (int i = 0; i < FAST_BOOT_EVENT_MAX; i++) {
+        if (marks[i]) {
+            printf(",%lld", marks[i]);
+        } else {
+            printf(",");
+        }
+    }
+    printf("\n");
+}
\ No newline at end of file
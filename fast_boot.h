@@ -0,0 +1,111 @@
+#ifndef _FAST_BOOT_H_
+#define _FAST_BOOT_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "audio_element.h"
+#include "esp_peripherals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Startup milestones
+ *
+ *          Times are esp_timer microseconds, which start counting in the application
+ *          startup code; ROM and second stage bootloader time are not included.
+ */
+typedef enum {
+    FAST_BOOT_APP_MAIN = 0,
+    FAST_BOOT_CODEC_READY,
+    FAST_BOOT_PIPELINE_READY,
+    FAST_BOOT_SD_MOUNTED,
+    FAST_BOOT_WIFI_CONNECTED,
+    FAST_BOOT_FIRST_SAMPLE,     /*!< First byte out of the capture element */
+    FAST_BOOT_FIRST_WRITE,      /*!< First byte through the sdcard writer */
+    FAST_BOOT_FIRST_SEND,       /*!< First byte handed to the network */
+    FAST_BOOT_EVENT_MAX,
+} fast_boot_event_t;
+
+typedef esp_err_t (*fast_boot_step_fn_t)(void *arg);
+typedef struct fast_boot_step *fast_boot_step_handle_t;
+
+/**
+ * @brief      Record a milestone now, only the first call per event counts
+ */
+void fast_boot_mark(fast_boot_event_t event);
+
+/**
+ * @brief      Record a milestone measured elsewhere, in esp_timer microseconds, 0 is ignored
+ */
+void fast_boot_mark_at(fast_boot_event_t event, int64_t time_us);
+
+/**
+ * @brief      Mark event once the element has moved its first byte
+ *
+ *             A low priority task polls byte_pos every tick until all watched elements
+ *             have fired, so the resolution is one tick.
+ */
+void fast_boot_watch(audio_element_handle_t el, fast_boot_event_t event);
+
+/**
+ * @brief      Mark FAST_BOOT_WIFI_CONNECTED once the station is associated, polled like fast_boot_watch
+ */
+void fast_boot_watch_wifi(esp_periph_handle_t wifi_handle);
+
+/**
+ * @brief      Run one startup step in its own task
+ *
+ * @param      name  Task name
+ * @param      fn    The step
+ * @param      arg   Passed to fn
+ *
+ * @return     Handle for fast_boot_step_wait, NULL when out of memory (fn has not run).
+ *             If the task cannot be created fn runs inline before this returns
+ */
+fast_boot_step_handle_t fast_boot_step_start(const char *name, fast_boot_step_fn_t fn, void *arg);
+
+/**
+ * @brief      Wait for a step to finish and free its handle
+ *
+ * @return     What the step returned, ESP_ERR_INVALID_ARG for a NULL handle
+ */
+esp_err_t fast_boot_step_wait(fast_boot_step_handle_t step);
+
+/**
+ * @brief      Mount the board sdcard at /sdcard, polling every tick
+ *
+ *             Same card setup as audio_board_sdcard_init, which polls in 500 ms steps.
+ *             Marks FAST_BOOT_SD_MOUNTED.
+ *
+ * @param      set         The peripheral set
+ * @param      timeout_ms  Give up after this long
+ *
+ * @return     ESP_OK once mounted, ESP_FAIL on timeout
+ */
+esp_err_t fast_boot_sdcard_mount(esp_periph_set_handle_t set, int timeout_ms);
+
+/**
+ * @brief      fast_boot_sdcard_mount as a step, set is the esp_periph_set_handle_t,
+ *             with the 2.5 s audio_board_sdcard_init allows
+ *
+ * @return     The mount result
+ */
+esp_err_t fast_boot_sdcard_step(void *set);
+
+/**
+ * @brief      Time of a milestone in esp_timer microseconds, 0 if it has not happened
+ */
+int64_t fast_boot_get(fast_boot_event_t event);
+
+/**
+ * @brief      Log the milestones in time order and print a BOOT,... CSV line
+ */
+void fast_boot_report(const char *scenario);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
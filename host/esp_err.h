@@ -0,0 +1,11 @@
+#ifndef _HOST_ESP_ERR_H_
+#define _HOST_ESP_ERR_H_
+
+typedef int esp_err_t;
+
+#define ESP_OK                  (0)
+#define ESP_FAIL                (-1)
+#define ESP_ERR_INVALID_STATE   (0x103)
+#define ESP_ERR_TIMEOUT         (0x107)
+
+#endif
\ No newline at end of file
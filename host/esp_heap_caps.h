@@ -0,0 +1,13 @@
+#ifndef _HOST_ESP_HEAP_CAPS_H_
+#define _HOST_ESP_HEAP_CAPS_H_
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_DMA          (1 << 3)
+#define MALLOC_CAP_8BIT         (1 << 2)
+#define MALLOC_CAP_INTERNAL     (1 << 11)
+
+#define heap_caps_malloc(size, caps)    malloc(size)
+#define heap_caps_free(p)               free(p)
+
+#endif
\ No newline at end of file
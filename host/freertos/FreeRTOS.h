@@ -0,0 +1,25 @@
+/* Host stand-ins for the few ESP-IDF and FreeRTOS calls the host tests need. Single task
+ * only: critical sections are no-ops, a queue never blocks and an empty one times out at once */
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "esp_err.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef int portMUX_TYPE;
+
+#define pdTRUE                          (1)
+#define pdFALSE                         (0)
+#define pdPASS                          (pdTRUE)
+#define portMAX_DELAY                   ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED    (0)
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+
+#endif
\ No newline at end of file
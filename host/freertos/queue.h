@@ -0,0 +1,58 @@
+#ifndef _HOST_QUEUE_H_
+#define _HOST_QUEUE_H_
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    int     len;
+    int     item;
+    int     head;
+    int     count;
+    uint8_t data[];
+} host_queue_t;
+
+typedef host_queue_t *QueueHandle_t;
+
+static inline QueueHandle_t xQueueCreate(int len, int item)
+{
+    QueueHandle_t q = calloc(1, sizeof(host_queue_t) + len * item);
+    if (q) {
+        q->len = len;
+        q->item = item;
+    }
+    return q;
+}
+
+static inline void vQueueDelete(QueueHandle_t q)
+{
+    free(q);
+}
+
+static inline BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    if (q->count == q->len) {
+        return pdFALSE;
+    }
+    memcpy(q->data + (q->head + q->count) % q->len * q->item, item, q->item);
+    q->count++;
+    return pdTRUE;
+}
+
+static inline BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    if (q->count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, q->data + q->head * q->item, q->item);
+    q->head = (q->head + 1) % q->len;
+    q->count--;
+    return pdTRUE;
+}
+
+static inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    return q->count;
+}
+
+#endif
\ No newline at end of file
@@ -13,11 +13,15 @@
 #include "board.h"
 #include "esp_peripherals.h"
 #include "i2s_stream.h"
+#include "tone_stream.h"
+#include "energy_model.h"
 #include <malloc.h>
 
 
 static const char *TAG = "ESPEAR";
 #define RECORD_TIME_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
 
 audio_element_err_t cb_nop(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait,void *context){
     return len;
@@ -33,6 +37,7 @@ void app_main(void)
     audio_element_handle_t i2s_stream_reader;
 
 
+#if !TEST_SIGNAL_SOURCE
     ESP_LOGI(TAG, "[ 1 ] Start codec chip");
     audio_board_handle_t board_handle = audio_board_init();
     
@@ -43,12 +48,19 @@ void app_main(void)
     board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
 
     audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#endif
 
     ESP_LOGI(TAG, "[2.0] Create audio pipeline for listening");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
     mem_assert(pipeline);
 
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.1] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = 16000;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
     ESP_LOGI(TAG, "[2.1] Create i2s stream to read audio data from codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
@@ -56,6 +68,7 @@ void app_main(void)
     i2s_cfg.type = AUDIO_STREAM_READER;
     i2s_cfg.std_cfg.clk_cfg.sample_rate_hz=16000;
     i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
     audio_element_set_write_cb(i2s_stream_reader, cb_nop, NULL);
 
     
@@ -76,6 +89,7 @@ void app_main(void)
     audio_pipeline_set_listener(pipeline, evt);
 
     ESP_LOGI(TAG, "[ 4 ] Start audio_pipeline");
+    energy_model_start();
     audio_pipeline_run(pipeline);
 
     ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_TIME_SECONDS);
@@ -95,6 +109,8 @@ void app_main(void)
             }
         }
     }
+    energy_model_report("input", second_recorded);
+
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
     audio_pipeline_stop(pipeline);
     audio_pipeline_wait_for_stop(pipeline);
@@ -0,0 +1,201 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "opus.h"
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "ogg_opus_pager.h"
+#include "opus_dyn_encoder.h"
+#include "ogg_opus_mux.h"
+
+static const char *TAG = "OGG_OPUS_MUX";
+
+#define OPUS_MAX_PACKET (1275)
+#define OPUS_PACKET_HEADER (2)
+#define OGG_OPUS_VENDOR "espear opus_dyn_encoder"
+
+typedef struct ogg_opus_mux {
+    ogg_opus_mux_cfg_t  cfg;
+    audio_element_handle_t self;
+    ogg_opus_pager_t    pager;
+    bool                open;
+    bool                headers_done;
+    ogg_opus_mux_stats_t stats;
+} ogg_opus_mux_t;
+
+static int _read_exact(audio_element_handle_t self, char *buf, int len)
+{
+    int got = 0;
+    while (got < len) {
+        int r = audio_element_input(self, buf + got, len - got);
+        if (r <= 0) {
+            return got ? AEL_IO_FAIL : r;
+        }
+        got += r;
+    }
+    return got;
+}
+
+// every finished page goes downstream in one write
+static int _emit_page(const uint8_t *page, int len, void *ctx)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)ctx;
+    return audio_element_output(m->self, (char *)page, len);
+}
+
+static void _sync_stats(ogg_opus_mux_t *m)
+{
+    m->stats.pages = m->pager.pages;
+    m->stats.bytes_out = m->pager.bytes_out;
+    m->stats.granule = m->pager.page_granule;
+    m->stats.next_seq = m->pager.page.seq;
+}
+
+static int _emit_headers(ogg_opus_mux_t *m)
+{
+    int pre_skip = m->cfg.encoder ? opus_dyn_encoder_get_pre_skip(m->cfg.encoder) : -1;
+    if (pre_skip < 0) {
+        pre_skip = m->cfg.pre_skip;
+    }
+    return ogg_opus_pager_headers(&m->pager, m->cfg.channels, pre_skip, m->cfg.input_sample_rate, OGG_OPUS_VENDOR);
+}
+
+static esp_err_t _mux_open(audio_element_handle_t self)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)audio_element_getdata(self);
+    if (m->open) {
+        return ESP_OK;
+    }
+    if (ogg_opus_pager_init(&m->pager, m->cfg.serial, m->cfg.max_page_bytes, m->cfg.page_ms, _emit_page, m) != 0) {
+        ESP_LOGE(TAG, "No memory for a %d byte page", m->cfg.max_page_bytes);
+        return ESP_FAIL;
+    }
+    m->open = true;
+    m->headers_done = false;
+    memset(&m->stats, 0, sizeof(m->stats));
+    if (m->cfg.resume) {
+        ogg_opus_pager_resume(&m->pager, m->cfg.start_seq, m->cfg.start_granule);
+        m->headers_done = true;
+    }
+    _sync_stats(m);
+    return ESP_OK;
+}
+
+static int _mux_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)audio_element_getdata(self);
+    uint8_t hdr[OPUS_PACKET_HEADER];
+    int r = _read_exact(self, (char *)hdr, OPUS_PACKET_HEADER);
+    // headers wait for the first packet, by then the encoder is open and knows its lookahead
+    if (!m->headers_done && (r >= 0 || r == AEL_IO_DONE)) {
+        int ret = _emit_headers(m);
+        _sync_stats(m);
+        if (ret <= 0) {
+            return ret;
+        }
+        m->headers_done = true;
+    }
+    if (r == AEL_IO_DONE || r == 0) {
+        int64_t start = esp_timer_get_time();
+        ogg_opus_pager_finish(&m->pager, m->cfg.eos);
+        m->stats.mux_us += esp_timer_get_time() - start;
+        _sync_stats(m);
+        return AEL_IO_DONE;
+    }
+    if (r < 0) {
+        return r;
+    }
+    int len = hdr[0] | (hdr[1] << 8);
+    if (len > OPUS_MAX_PACKET || len > in_len) {
+        ESP_LOGE(TAG, "Bad packet length %d, is packet_header enabled on the encoder?", len);
+        return AEL_IO_FAIL;
+    }
+    r = _read_exact(self, in_buffer, len);
+    if (r != len) {
+        return r < 0 ? r : AEL_IO_FAIL;
+    }
+    m->stats.packets++;
+
+    int64_t start = esp_timer_get_time();
+    int samples = opus_packet_get_nb_samples((const unsigned char *)in_buffer, len, 48000);
+    if (samples < 0) {
+        samples = 0;
+    }
+    int ret = ogg_opus_pager_packet(&m->pager, (const uint8_t *)in_buffer, len, samples);
+    m->stats.mux_us += esp_timer_get_time() - start;
+    _sync_stats(m);
+    if (ret <= 0) {
+        return ret;
+    }
+    audio_element_update_byte_pos(self, len);
+    return len;
+}
+
+static esp_err_t _mux_close(audio_element_handle_t self)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)audio_element_getdata(self);
+    ogg_opus_pager_deinit(&m->pager);
+    m->open = false;
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_report_info(self);
+        audio_element_set_byte_pos(self, 0);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _mux_destroy(audio_element_handle_t self)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)audio_element_getdata(self);
+    audio_free(m);
+    return ESP_OK;
+}
+
+esp_err_t ogg_opus_mux_get_stats(audio_element_handle_t self, ogg_opus_mux_stats_t *stats)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, m, return ESP_FAIL);
+    memcpy(stats, &m->stats, sizeof(*stats));
+    return ESP_OK;
+}
+
+esp_err_t ogg_opus_mux_set_resume(audio_element_handle_t self, bool resume, uint32_t seq, int64_t granule)
+{
+    ogg_opus_mux_t *m = (ogg_opus_mux_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, m, return ESP_FAIL);
+    m->cfg.resume = resume;
+    m->cfg.start_seq = seq;
+    m->cfg.start_granule = granule;
+    return ESP_OK;
+}
+
+audio_element_handle_t ogg_opus_mux_init(ogg_opus_mux_cfg_t *config)
+{
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    ogg_opus_mux_t *m = audio_calloc(1, sizeof(ogg_opus_mux_t));
+    AUDIO_MEM_CHECK(TAG, m, return NULL);
+    memcpy(&m->cfg, config, sizeof(ogg_opus_mux_cfg_t));
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _mux_open;
+    cfg.close = _mux_close;
+    cfg.process = _mux_process;
+    cfg.destroy = _mux_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.buffer_len = OPUS_MAX_PACKET;
+    cfg.tag = "ogg";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(m);
+        return NULL;
+    });
+    m->self = el;
+    audio_element_setdata(el, m);
+    return el;
+}
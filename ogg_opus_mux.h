@@ -0,0 +1,103 @@
+#ifndef _OGG_OPUS_MUX_H_
+#define _OGG_OPUS_MUX_H_
+
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Ogg Opus muxer configuration
+ *
+ *          Sits between opus_dyn_encoder (with packet_header enabled) and a writer. Packets
+ *          are collected into pages of page_ms and each page goes downstream in one piece,
+ *          so the writer sees a few large writes instead of one per packet.
+ */
+typedef struct {
+    int         channels;           /*!< Channels of the encoded stream */
+    int         input_sample_rate;  /*!< Sample rate fed to the encoder, informational for decoders */
+    audio_element_handle_t encoder; /*!< opus_dyn_encoder feeding the mux, the pre-skip is read from it */
+    int         pre_skip;           /*!< Encoder lookahead in 48 kHz samples, used when encoder is NULL */
+    int         page_ms;            /*!< Audio duration per page */
+    int         max_page_bytes;     /*!< Page body limit, a page is closed early when it is reached */
+    uint32_t    serial;             /*!< Stream serial number */
+    bool        eos;                /*!< Flag the last page as end of stream, turn off when a later run appends */
+    bool        resume;             /*!< Continue an earlier stream: no header pages, numbering from start_seq/start_granule */
+    uint32_t    start_seq;          /*!< First page sequence number when resuming */
+    int64_t     start_granule;      /*!< Granule position to continue from when resuming */
+    int         out_rb_size;        /*!< Output ringbuffer size */
+    int         task_stack;         /*!< Task stack size */
+    int         task_core;          /*!< Task running in core */
+    int         task_prio;          /*!< Task priority */
+} ogg_opus_mux_cfg_t;
+
+/**
+ * @brief   Muxer counters
+ */
+typedef struct {
+    int64_t     packets;            /*!< Opus packets received */
+    int64_t     pages;              /*!< Pages written, i.e. writes handed to the sink */
+    int64_t     bytes_out;          /*!< Bytes written including Ogg overhead */
+    int64_t     granule;            /*!< Granule position of the last finished page */
+    uint32_t    next_seq;           /*!< Sequence number the next page gets, start_seq for a resumed stream */
+    int64_t     mux_us;             /*!< Time spent building pages */
+} ogg_opus_mux_stats_t;
+
+#define OGG_OPUS_MUX_TASK_STACK     (3 * 1024)
+#define OGG_OPUS_MUX_TASK_CORE      (0)
+#define OGG_OPUS_MUX_TASK_PRIO      (5)
+#define OGG_OPUS_MUX_RINGBUFFER_SIZE (16 * 1024)
+
+#define OGG_OPUS_MUX_CFG_DEFAULT() {                \
+    .channels = 1,                                  \
+    .input_sample_rate = 16000,                     \
+    .encoder = NULL,                                \
+    .pre_skip = 312,                                \
+    .page_ms = 1000,                                \
+    .max_page_bytes = 8 * 1024,                     \
+    .serial = 0x45535045,                           \
+    .eos = true,                                    \
+    .resume = false,                                \
+    .out_rb_size = OGG_OPUS_MUX_RINGBUFFER_SIZE,    \
+    .task_stack = OGG_OPUS_MUX_TASK_STACK,          \
+    .task_core = OGG_OPUS_MUX_TASK_CORE,            \
+    .task_prio = OGG_OPUS_MUX_TASK_PRIO,            \
+}
+
+/**
+ * @brief      Create an Ogg Opus muxer element
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL on failure
+ */
+audio_element_handle_t ogg_opus_mux_init(ogg_opus_mux_cfg_t *config);
+
+/**
+ * @brief      Read the muxer counters
+ *
+ * @param      self   The muxer handle
+ * @param      stats  Filled with the current values
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t ogg_opus_mux_get_stats(audio_element_handle_t self, ogg_opus_mux_stats_t *stats);
+
+/**
+ * @brief      Change the resume fields of the configuration, used at the next open
+ *
+ * @param      self     The muxer handle
+ * @param      resume   Continue an earlier stream instead of starting with header pages
+ * @param      seq      start_seq
+ * @param      granule  start_granule
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t ogg_opus_mux_set_resume(audio_element_handle_t self, bool resume, uint32_t seq, int64_t granule);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "ogg_opus_pager.h"
+
+static int _emit_page(ogg_opus_pager_t *p, int flags)
+{
+    const uint8_t *data;
+    int len = ogg_page_finish(&p->page, p->granule, flags, &data);
+    p->page_samples = 0;
+    p->pages++;
+    p->bytes_out += len;
+    p->page_granule = p->granule;
+    return p->emit(data, len, p->ctx);
+}
+
+int ogg_opus_pager_init(ogg_opus_pager_t *p, uint32_t serial, int max_page_bytes, int page_ms,
+                        ogg_opus_pager_emit_t emit, void *ctx)
+{
+    memset(p, 0, sizeof(*p));
+    if (ogg_page_init(&p->page, serial, max_page_bytes) != 0) {
+        return -1;
+    }
+    p->emit = emit;
+    p->ctx = ctx;
+    p->page_limit = page_ms * 48;
+    return 0;
+}
+
+void ogg_opus_pager_deinit(ogg_opus_pager_t *p)
+{
+    ogg_page_deinit(&p->page);
+}
+
+void ogg_opus_pager_resume(ogg_opus_pager_t *p, uint32_t seq, int64_t granule)
+{
+    p->page.seq = seq;
+    p->granule = granule;
+    p->page_granule = granule;
+}
+
+int ogg_opus_pager_headers(ogg_opus_pager_t *p, int channels, int pre_skip, uint32_t input_sample_rate,
+                           const char *vendor)
+{
+    uint8_t hdr[64];
+    // each header packet must sit alone on its page
+    int n = ogg_opus_head(hdr, channels, pre_skip, input_sample_rate);
+    ogg_page_add_packet(&p->page, hdr, n);
+    int ret = _emit_page(p, OGG_PAGE_BOS);
+    if (ret <= 0) {
+        return ret;
+    }
+    n = ogg_opus_tags(hdr, sizeof(hdr), vendor);
+    ogg_page_add_packet(&p->page, hdr, n);
+    return _emit_page(p, 0);
+}
+
+int ogg_opus_pager_packet(ogg_opus_pager_t *p, const uint8_t *packet, int len, int samples)
+{
+    int ret = 1;
+    if (!ogg_page_fits(&p->page, len)) {
+        ret = _emit_page(p, 0);
+        if (ret <= 0) {
+            return ret;
+        }
+    }
+    ogg_page_add_packet(&p->page, packet, len);
+    p->granule += samples;
+    p->page_samples += samples;
+    if (p->page_samples >= p->page_limit) {
+        ret = _emit_page(p, 0);
+    }
+    return ret;
+}
+
+int ogg_opus_pager_finish(ogg_opus_pager_t *p, bool eos)
+{
+    // close the stream on the last page, even if it is empty, ogg_page_finish gives that granule -1
+    if (p->page.packets || (eos && p->pages > 0)) {
+        return _emit_page(p, eos ? OGG_PAGE_EOS : 0);
+    }
+    return 1;
+}
\ No newline at end of file
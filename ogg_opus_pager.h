@@ -0,0 +1,108 @@
+#ifndef _OGG_OPUS_PAGER_H_
+#define _OGG_OPUS_PAGER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ogg_page.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief      Takes a finished page, returns what the caller should see: > 0 to go on,
+ *             0 or a negative error to stop
+ */
+typedef int (*ogg_opus_pager_emit_t)(const uint8_t *page, int len, void *ctx);
+
+/**
+ * @brief   Turns Opus packets into an Ogg Opus stream
+ *
+ *          The packet to page half of ogg_opus_mux: header pages, granule positions, pages
+ *          of page_ms, the end of stream page and resuming a stream another run started.
+ *          Plain C, no ESP dependencies, the caller counts the samples of each packet.
+ */
+typedef struct {
+    ogg_page_writer_t       page;
+    ogg_opus_pager_emit_t   emit;
+    void                    *ctx;
+    int                     page_limit;     /*!< 48 kHz samples that close a page */
+    int                     page_samples;   /*!< 48 kHz samples on the page being built */
+    int64_t                 granule;        /*!< Granule position after the last packet */
+    int64_t                 pages;          /*!< Pages emitted */
+    int64_t                 bytes_out;      /*!< Bytes emitted including Ogg overhead */
+    int64_t                 page_granule;   /*!< Granule position of the last finished page */
+} ogg_opus_pager_t;
+
+/**
+ * @brief      Allocate the page buffer and start a stream at sequence 0, granule 0
+ *
+ * @param      p               The pager
+ * @param      serial          Stream serial number
+ * @param      max_page_bytes  Page body limit, a page is closed early when it is reached
+ * @param      page_ms         Audio duration per page
+ * @param      emit            Called with every finished page
+ * @param      ctx             Passed to emit
+ *
+ * @return     0 on success, -1 when out of memory
+ */
+int ogg_opus_pager_init(ogg_opus_pager_t *p, uint32_t serial, int max_page_bytes, int page_ms,
+                        ogg_opus_pager_emit_t emit, void *ctx);
+
+/**
+ * @brief      Free the page buffer
+ */
+void ogg_opus_pager_deinit(ogg_opus_pager_t *p);
+
+/**
+ * @brief      Continue an earlier stream instead, call before anything is emitted
+ *
+ * @param      p        The pager
+ * @param      seq      Sequence number of the next page
+ * @param      granule  Granule position the earlier stream ended at
+ */
+void ogg_opus_pager_resume(ogg_opus_pager_t *p, uint32_t seq, int64_t granule);
+
+/**
+ * @brief      Emit the OpusHead and OpusTags pages
+ *
+ * @param      p                  The pager
+ * @param      channels           Channels of the encoded stream
+ * @param      pre_skip           Encoder lookahead in 48 kHz samples
+ * @param      input_sample_rate  Sample rate fed to the encoder
+ * @param      vendor             Vendor string for OpusTags
+ *
+ * @return     The emit result of the last page
+ */
+int ogg_opus_pager_headers(ogg_opus_pager_t *p, int channels, int pre_skip, uint32_t input_sample_rate,
+                           const char *vendor);
+
+/**
+ * @brief      Add one packet, emitting the page before it when it does not fit and the page
+ *             it closes when it completes page_ms
+ *
+ * @param      p        The pager
+ * @param      packet   The Opus packet
+ * @param      len      Packet length
+ * @param      samples  Packet duration in 48 kHz samples
+ *
+ * @return     1 when nothing was emitted, otherwise the emit result
+ */
+int ogg_opus_pager_packet(ogg_opus_pager_t *p, const uint8_t *packet, int len, int samples);
+
+/**
+ * @brief      Emit what is left at the end of the input
+ *
+ *          With eos the last page carries the end of stream flag, an empty one is written
+ *          if the input stopped on a page boundary. Without it only a partial page is
+ *          emitted, so a later run can resume the stream.
+ *
+ * @return     1 when nothing was emitted, otherwise the emit result
+ */
+int ogg_opus_pager_finish(ogg_opus_pager_t *p, bool eos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,337 @@
+/* Host test for ogg_opus_pager.c, the packet to page half of ogg_opus_mux: header pages,
+ * granule positions, page_ms batching, early closes at max_page_bytes, the end of stream
+ * page and a stream resumed by a later run.
+ *
+ *     cc -O2 -o ogg_opus_pager_test ogg_opus_pager_test.c ogg_opus_pager.c ogg_page.c
+ *
+ * With libopus and libopusfile installed the stream is also encoded for real and read back
+ * with op_open_memory, checked for its length and seeked into:
+ *
+ *     cc -O2 -DOGG_TEST_OPUSFILE=1 $(pkg-config --cflags opusfile) -o ogg_opus_pager_test \
+ *         ogg_opus_pager_test.c ogg_opus_pager.c ogg_page.c $(pkg-config --libs opusfile opus) -lm
+ *
+ * Every mismatch is printed, the run exits with 1 if there was any.
+ */
+#ifndef ESP_PLATFORM
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ogg_opus_pager.h"
+
+#ifndef OGG_TEST_OPUSFILE
+#define OGG_TEST_OPUSFILE (0)
+#endif
+#if OGG_TEST_OPUSFILE
+#include <math.h>
+#include <opus.h>
+#include <opusfile.h>
+#endif
+
+#define TEST_SERIAL     (0x5eed0456u)
+#define TEST_PRE_SKIP   (312)
+#define TEST_FRAME      (960)
+#define TEST_PAGE_MS    (100)
+#define TEST_MAX_PAGES  (32)
+#define TEST_VENDOR     "ogg_opus_pager_test"
+
+typedef struct {
+    int         flags;
+    int64_t     granule;
+    uint32_t    serial;
+    uint32_t    seq;
+    int         packets;
+    const uint8_t *first;       /*!< First packet, for the header pages */
+    int         first_len;
+} parsed_page_t;
+
+static uint8_t stream[256 * 1024];
+static int stream_len;
+static int fail_emit;
+static int failures;
+
+#define CHECK(cond, ...) do {                   \
+    if (!(cond)) {                              \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        failures++;                             \
+    }                                           \
+} while (0)
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// stands in for audio_element_output, fail_emit makes it refuse like a stopped ringbuffer
+static int emit(const uint8_t *page, int len, void *ctx)
+{
+    (void)ctx;
+    if (fail_emit) {
+        return -1;
+    }
+    if (stream_len + len > (int)sizeof(stream)) {
+        printf("FAIL: test stream buffer too small\n");
+        failures++;
+        return -1;
+    }
+    memcpy(stream + stream_len, page, len);
+    stream_len += len;
+    return len;
+}
+
+// splits the stream back into pages, the CRCs are ogg_page_test's business
+static int parse_stream(parsed_page_t *pages)
+{
+    int count = 0;
+    for (int off = 0; off < stream_len; count++) {
+        const uint8_t *buf = stream + off;
+        if (count == TEST_MAX_PAGES || stream_len - off < 27 || memcmp(buf, "OggS", 4) != 0) {
+            printf("FAIL: malformed or too many pages at byte %d\n", off);
+            failures++;
+            return count;
+        }
+        int nseg = buf[26];
+        int body = 0;
+        parsed_page_t *pp = &pages[count];
+        pp->packets = 0;
+        for (int i = 0; i < nseg; i++) {
+            body += buf[27 + i];
+            pp->packets += buf[27 + i] < 255;
+        }
+        pp->flags = buf[5];
+        pp->granule = (int64_t)((uint64_t)rd32(buf + 6) | (uint64_t)rd32(buf + 10) << 32);
+        pp->serial = rd32(buf + 14);
+        pp->seq = rd32(buf + 18);
+        pp->first = buf + 27 + nseg;
+        pp->first_len = nseg ? buf[27] : 0;
+        off += 27 + nseg + body;
+    }
+    return count;
+}
+
+static void add_packets(ogg_opus_pager_t *p, int count, int len)
+{
+    uint8_t pkt[1275];
+    for (int i = 0; i < count; i++) {
+        memset(pkt, i, len);
+        CHECK(ogg_opus_pager_packet(p, pkt, len, TEST_FRAME) > 0, "packet %d refused", i);
+    }
+}
+
+static void start(ogg_opus_pager_t *p, int max_page_bytes, bool headers)
+{
+    stream_len = 0;
+    fail_emit = 0;
+    if (ogg_opus_pager_init(p, TEST_SERIAL, max_page_bytes, TEST_PAGE_MS, emit, NULL) != 0) {
+        printf("FAIL: no memory\n");
+        failures++;
+        return;
+    }
+    if (headers) {
+        CHECK(ogg_opus_pager_headers(p, 1, TEST_PRE_SKIP, 16000, TEST_VENDOR) > 0, "header pages refused");
+    }
+}
+
+// 12 frames of 20 ms: two full 100 ms pages, then the rest on the end of stream page
+static void check_batching(void)
+{
+    ogg_opus_pager_t p;
+    parsed_page_t pages[TEST_MAX_PAGES];
+    start(&p, 8192, true);
+    add_packets(&p, 12, 60);
+    ogg_opus_pager_finish(&p, true);
+    int count = parse_stream(pages);
+    CHECK(count == 5 && p.pages == 5, "%d pages parsed, %lld counted, expected 5", count, (long long)p.pages);
+    CHECK(p.bytes_out == stream_len, "%lld bytes counted, %d emitted", (long long)p.bytes_out, stream_len);
+    if (count == 5) {
+        CHECK(pages[0].flags == OGG_PAGE_BOS && pages[0].first_len == 19
+              && memcmp(pages[0].first, "OpusHead", 8) == 0, "OpusHead page");
+        CHECK((pages[0].first[10] | pages[0].first[11] << 8) == TEST_PRE_SKIP, "pre-skip %d",
+              pages[0].first[10] | pages[0].first[11] << 8);
+        CHECK(pages[1].flags == 0 && memcmp(pages[1].first, "OpusTags", 8) == 0, "OpusTags page");
+        CHECK(pages[0].granule == 0 && pages[1].granule == 0, "header granules %lld %lld",
+              (long long)pages[0].granule, (long long)pages[1].granule);
+        CHECK(pages[2].packets == 5 && pages[2].granule == 5 * TEST_FRAME, "first audio page %d packets granule %lld",
+              pages[2].packets, (long long)pages[2].granule);
+        CHECK(pages[3].packets == 5 && pages[3].granule == 10 * TEST_FRAME, "second audio page %d packets granule %lld",
+              pages[3].packets, (long long)pages[3].granule);
+        CHECK(pages[4].flags == OGG_PAGE_EOS && pages[4].packets == 2 && pages[4].granule == 12 * TEST_FRAME,
+              "last page flags %02x, %d packets, granule %lld", pages[4].flags, pages[4].packets,
+              (long long)pages[4].granule);
+        for (int i = 0; i < count; i++) {
+            CHECK(pages[i].serial == TEST_SERIAL && pages[i].seq == (uint32_t)i, "page %d serial %08x seq %u", i,
+                  (unsigned)pages[i].serial, (unsigned)pages[i].seq);
+        }
+    }
+    ogg_opus_pager_deinit(&p);
+}
+
+// input that stops on a page boundary still ends with an end of stream page, an empty one
+static void check_eos_on_boundary(void)
+{
+    ogg_opus_pager_t p;
+    parsed_page_t pages[TEST_MAX_PAGES];
+    start(&p, 8192, true);
+    add_packets(&p, 10, 60);
+    ogg_opus_pager_finish(&p, true);
+    int count = parse_stream(pages);
+    CHECK(count == 5, "%d pages, expected 5", count);
+    if (count == 5) {
+        CHECK(pages[4].flags == OGG_PAGE_EOS && pages[4].packets == 0 && pages[4].granule == -1,
+              "empty EOS page flags %02x, %d packets, granule %lld", pages[4].flags, pages[4].packets,
+              (long long)pages[4].granule);
+    }
+    CHECK(p.page_granule == 10 * TEST_FRAME, "stream granule %lld", (long long)p.page_granule);
+    ogg_opus_pager_deinit(&p);
+}
+
+// a page body limit closes pages before page_ms is reached
+static void check_max_page_bytes(void)
+{
+    ogg_opus_pager_t p;
+    parsed_page_t pages[TEST_MAX_PAGES];
+    start(&p, 1000, false);
+    add_packets(&p, 3, 400);
+    ogg_opus_pager_finish(&p, false);
+    int count = parse_stream(pages);
+    CHECK(count == 2, "%d pages, expected 2", count);
+    if (count == 2) {
+        CHECK(pages[0].packets == 2 && pages[0].granule == 2 * TEST_FRAME, "early page %d packets granule %lld",
+              pages[0].packets, (long long)pages[0].granule);
+        CHECK(pages[1].packets == 1 && pages[1].flags == 0, "last page %d packets flags %02x", pages[1].packets,
+              pages[1].flags);
+    }
+    ogg_opus_pager_deinit(&p);
+}
+
+// duty cycle mode: one run leaves the stream open, the next continues it without headers
+static void check_resume(void)
+{
+    ogg_opus_pager_t p;
+    parsed_page_t pages[TEST_MAX_PAGES];
+    start(&p, 8192, true);
+    add_packets(&p, 7, 60);
+    ogg_opus_pager_finish(&p, false);
+    uint32_t next_seq = p.page.seq;
+    int64_t granule = p.page_granule;
+    ogg_opus_pager_deinit(&p);
+    int first_len = stream_len;
+
+    if (ogg_opus_pager_init(&p, TEST_SERIAL, 8192, TEST_PAGE_MS, emit, NULL) != 0) {
+        printf("FAIL: no memory\n");
+        failures++;
+        return;
+    }
+    ogg_opus_pager_resume(&p, next_seq, granule);
+    add_packets(&p, 3, 60);
+    ogg_opus_pager_finish(&p, true);
+    ogg_opus_pager_deinit(&p);
+    CHECK(stream_len > first_len, "resumed run wrote nothing");
+
+    int count = parse_stream(pages);
+    CHECK(count == 5, "%d pages over both runs, expected 5", count);
+    int64_t last = 0;
+    for (int i = 0; i < count; i++) {
+        CHECK(pages[i].seq == (uint32_t)i, "page %d has sequence %u", i, (unsigned)pages[i].seq);
+        CHECK((pages[i].flags & OGG_PAGE_BOS) == (i == 0 ? OGG_PAGE_BOS : 0), "page %d flags %02x", i, pages[i].flags);
+        CHECK(pages[i].granule >= last, "page %d granule %lld goes back", i, (long long)pages[i].granule);
+        last = pages[i].granule;
+    }
+    if (count == 5) {
+        CHECK(pages[3].flags == 0 && pages[3].granule == 7 * TEST_FRAME, "first run ends open at %lld",
+              (long long)pages[3].granule);
+        CHECK(pages[4].flags == OGG_PAGE_EOS && pages[4].granule == 10 * TEST_FRAME, "resumed run ends flags %02x at %lld",
+              pages[4].flags, (long long)pages[4].granule);
+    }
+}
+
+// a refused page stops the pager with the sink's answer
+static void check_emit_failure(void)
+{
+    ogg_opus_pager_t p;
+    uint8_t pkt[60] = {0};
+    start(&p, 8192, false);
+    for (int i = 0; i < 4; i++) {
+        CHECK(ogg_opus_pager_packet(&p, pkt, sizeof(pkt), TEST_FRAME) > 0, "packet %d refused", i);
+    }
+    fail_emit = 1;
+    CHECK(ogg_opus_pager_packet(&p, pkt, sizeof(pkt), TEST_FRAME) == -1, "a refused page was not reported");
+    ogg_opus_pager_deinit(&p);
+}
+
+#if OGG_TEST_OPUSFILE
+#define RT_RATE     (16000)
+#define RT_FRAMES   (150)
+
+// three seconds of a tone through libopus and the pager, read back with libopusfile
+static void check_opusfile(void)
+{
+    ogg_opus_pager_t p;
+    int err;
+    OpusEncoder *enc = opus_encoder_create(RT_RATE, 1, OPUS_APPLICATION_AUDIO, &err);
+    if (enc == NULL) {
+        printf("FAIL: opus_encoder_create %d\n", err);
+        failures++;
+        return;
+    }
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
+    int pre_skip = lookahead * (48000 / RT_RATE);
+    start(&p, 8192, false);
+    CHECK(ogg_opus_pager_headers(&p, 1, pre_skip, RT_RATE, TEST_VENDOR) > 0, "header pages refused");
+    int16_t pcm[RT_RATE / 50];
+    uint8_t pkt[1275];
+    for (int f = 0; f < RT_FRAMES; f++) {
+        for (int i = 0; i < RT_RATE / 50; i++) {
+            pcm[i] = (int16_t)(8000 * sin(2 * M_PI * 440 * (f * (RT_RATE / 50) + i) / RT_RATE));
+        }
+        int n = opus_encode(enc, pcm, RT_RATE / 50, pkt, sizeof(pkt));
+        CHECK(n > 0, "opus_encode %d", n);
+        if (n > 0) {
+            ogg_opus_pager_packet(&p, pkt, n, opus_packet_get_nb_samples(pkt, n, 48000));
+        }
+    }
+    ogg_opus_pager_finish(&p, true);
+    ogg_opus_pager_deinit(&p);
+    opus_encoder_destroy(enc);
+
+    OggOpusFile *of = op_open_memory(stream, stream_len, &err);
+    CHECK(of != NULL, "op_open_memory %d", err);
+    if (of == NULL) {
+        return;
+    }
+    const OpusHead *head = op_head(of, -1);
+    CHECK(head && head->pre_skip == pre_skip && head->input_sample_rate == RT_RATE, "OpusHead read back");
+    ogg_int64_t total = op_pcm_total(of, -1);
+    CHECK(total == (ogg_int64_t)RT_FRAMES * TEST_FRAME - pre_skip, "op_pcm_total %lld, expected %lld",
+          (long long)total, (long long)RT_FRAMES * TEST_FRAME - pre_skip);
+    CHECK(op_pcm_seek(of, total / 2) == 0, "seek to the middle");
+    CHECK(op_pcm_tell(of) == total / 2, "op_pcm_tell %lld after the seek", (long long)op_pcm_tell(of));
+    opus_int16 out[5760];
+    int64_t decoded = op_pcm_tell(of);
+    int n;
+    while ((n = op_read(of, out, sizeof(out) / sizeof(out[0]), NULL)) > 0) {
+        decoded += n;
+    }
+    CHECK(n == 0 && decoded == total, "decoding from the middle ended at %lld (%d)", (long long)decoded, n);
+    op_free(of);
+}
+#endif
+
+int main(void)
+{
+    check_batching();
+    check_eos_on_boundary();
+    check_max_page_bytes();
+    check_resume();
+    check_emit_failure();
+#if OGG_TEST_OPUSFILE
+    check_opusfile();
+#endif
+    printf("%s: %d failures%s\n", failures ? "FAIL" : "PASS", failures,
+           OGG_TEST_OPUSFILE ? "" : ", opusfile round trip not built");
+    return failures ? 1 : 0;
+}
+#endif
\ No newline at end of file
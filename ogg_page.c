@@ -0,0 +1,131 @@
+#include <string.h>
+#include <stdlib.h>
+#include "ogg_page.h"
+
+static uint32_t crc_table[256];
+
+// Ogg uses the direct (non reflected) CRC-32 with polynomial 0x04C11DB7, no final xor
+static void crc_init(void)
+{
+    if (crc_table[1]) {
+        return;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t r = i << 24;
+        for (int j = 0; j < 8; j++) {
+            r = r & 0x80000000u ? (r << 1) ^ 0x04C11DB7u : r << 1;
+        }
+        crc_table[i] = r;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t *p, int len)
+{
+    while (len--) {
+        crc = (crc << 8) ^ crc_table[((crc >> 24) ^ *p++) & 0xFF];
+    }
+    return crc;
+}
+
+static void wr16(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void wr32(uint8_t *p, uint32_t v)
+{
+    wr16(p, v);
+    wr16(p + 2, v >> 16);
+}
+
+int ogg_page_init(ogg_page_writer_t *w, uint32_t serial, int max_data)
+{
+    crc_init();
+    memset(w, 0, sizeof(*w));
+    w->buf = malloc(OGG_PAGE_MAX_HEADER + max_data);
+    if (w->buf == NULL) {
+        return -1;
+    }
+    w->serial = serial;
+    w->max_data = max_data;
+    return 0;
+}
+
+void ogg_page_deinit(ogg_page_writer_t *w)
+{
+    free(w->buf);
+    w->buf = NULL;
+}
+
+int ogg_page_fits(const ogg_page_writer_t *w, int len)
+{
+    return w->nseg + len / 255 + 1 <= 255 && w->data_len + len <= w->max_data;
+}
+
+void ogg_page_add_packet(ogg_page_writer_t *w, const uint8_t *packet, int len)
+{
+    uint8_t *lacing = w->buf + 27;
+    memcpy(w->buf + OGG_PAGE_MAX_HEADER + w->data_len, packet, len);
+    w->data_len += len;
+    // lacing values go to the header area for now, they are moved next to the header in finish
+    for (int left = len; ; left -= 255) {
+        lacing[w->nseg++] = left >= 255 ? 255 : left;
+        if (left < 255) {
+            break;
+        }
+    }
+    w->packets++;
+}
+
+int ogg_page_finish(ogg_page_writer_t *w, int64_t granule, int flags, const uint8_t **page)
+{
+    int header_len = 27 + w->nseg;
+    uint8_t *h = w->buf + OGG_PAGE_MAX_HEADER - header_len;
+    memmove(h + 27, w->buf + 27, w->nseg);
+    memcpy(h, "OggS", 4);
+    h[4] = 0;
+    h[5] = flags;
+    // a page on which no packet ends has no granule position of its own
+    if (w->packets == 0) {
+        granule = -1;
+    }
+    wr32(h + 6, (uint32_t)granule);
+    wr32(h + 10, (uint32_t)((uint64_t)granule >> 32));
+    wr32(h + 14, w->serial);
+    wr32(h + 18, w->seq++);
+    wr32(h + 22, 0);
+    h[26] = w->nseg;
+    int len = header_len + w->data_len;
+    wr32(h + 22, crc_update(0, h, len));
+    *page = h;
+    w->data_len = 0;
+    w->nseg = 0;
+    w->packets = 0;
+    return len;
+}
+
+int ogg_opus_head(uint8_t *out, int channels, int pre_skip, uint32_t input_sample_rate)
+{
+    memcpy(out, "OpusHead", 8);
+    out[8] = 1;
+    out[9] = channels;
+    wr16(out + 10, pre_skip);
+    wr32(out + 12, input_sample_rate);
+    wr16(out + 16, 0);
+    out[18] = 0;
+    return 19;
+}
+
+int ogg_opus_tags(uint8_t *out, int cap, const char *vendor)
+{
+    int vlen = strlen(vendor);
+    if (cap < 8 + 4 + vlen + 4) {
+        return -1;
+    }
+    memcpy(out, "OpusTags", 8);
+    wr32(out + 8, vlen);
+    memcpy(out + 12, vendor, vlen);
+    wr32(out + 12 + vlen, 0);
+    return 16 + vlen;
+}
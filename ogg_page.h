@@ -0,0 +1,91 @@
+#ifndef _OGG_PAGE_H_
+#define _OGG_PAGE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OGG_PAGE_CONTINUED  (0x01)
+#define OGG_PAGE_BOS        (0x02)
+#define OGG_PAGE_EOS        (0x04)
+#define OGG_PAGE_MAX_HEADER (27 + 255)
+
+/**
+ * @brief   Builds Ogg pages one packet at a time
+ *
+ *          Packets are copied once into the page buffer, the header is filled in in front
+ *          of them when the page is finished, so a finished page is one contiguous block.
+ *          Plain C, no ESP dependencies.
+ */
+typedef struct {
+    uint32_t    serial;
+    uint32_t    seq;        /*!< Sequence number of the next page */
+    uint8_t     *buf;
+    int         max_data;
+    int         data_len;
+    int         nseg;
+    int         packets;    /*!< Packets in the page being built */
+} ogg_page_writer_t;
+
+/**
+ * @brief      Allocate the page buffer
+ *
+ * @param      w         The writer
+ * @param      serial    Stream serial number
+ * @param      max_data  Largest page body in bytes
+ *
+ * @return     0 on success, -1 when out of memory
+ */
+int ogg_page_init(ogg_page_writer_t *w, uint32_t serial, int max_data);
+
+/**
+ * @brief      Free the page buffer
+ */
+void ogg_page_deinit(ogg_page_writer_t *w);
+
+/**
+ * @brief      Check whether a packet still fits in the current page
+ *
+ * @return     1 if it fits, 0 if the page has to be finished first
+ */
+int ogg_page_fits(const ogg_page_writer_t *w, int len);
+
+/**
+ * @brief      Append a whole packet, the caller checks ogg_page_fits first
+ */
+void ogg_page_add_packet(ogg_page_writer_t *w, const uint8_t *packet, int len);
+
+/**
+ * @brief      Close the current page
+ *
+ * @param      w        The writer
+ * @param      granule  Granule position at the end of the last packet on the page, written as -1
+ *                      when the page holds no packet, e.g. an empty end of stream page
+ * @param      flags    OGG_PAGE_BOS / OGG_PAGE_EOS
+ * @param      page     Set to the start of the finished page, valid until the next add
+ *
+ * @return     Page length in bytes
+ */
+int ogg_page_finish(ogg_page_writer_t *w, int64_t granule, int flags, const uint8_t **page);
+
+/**
+ * @brief      Write an OpusHead packet, mapping family 0
+ *
+ * @return     Packet length, 19
+ */
+int ogg_opus_head(uint8_t *out, int channels, int pre_skip, uint32_t input_sample_rate);
+
+/**
+ * @brief      Write an OpusTags packet without user comments
+ *
+ * @return     Packet length, or -1 if cap is too small
+ */
+int ogg_opus_tags(uint8_t *out, int cap, const char *vendor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,252 @@
+/* Host round trip for ogg_page.c: builds an Ogg Opus stream, parses it back and checks
+ * the page CRCs, the lacing, the granule positions and the header fields.
+ *
+ *     cc -O2 -o ogg_page_test ogg_page_test.c ogg_page.c
+ *
+ * Every mismatch is printed, the run exits with 1 if there was any.
+ */
+#ifndef ESP_PLATFORM
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "ogg_page.h"
+
+#define TEST_SERIAL     (0x5eed0123u)
+#define TEST_PRE_SKIP   (312)
+#define TEST_MAX_DATA   (4096)
+#define TEST_FRAME      (960)
+#define TEST_MAX_PAGES  (8)
+#define TEST_MAX_PKTS   (16)
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+// lengths that sit on and around the 255 byte lacing boundaries, and an empty packet
+static const int packet_sizes[] = { 0, 1, 254, 255, 510, 1000 };
+
+typedef struct {
+    int         flags;
+    int64_t     granule;
+    uint32_t    serial;
+    uint32_t    seq;
+    int         packets;
+    int         len[TEST_MAX_PKTS];
+    const uint8_t *data[TEST_MAX_PKTS];
+} parsed_page_t;
+
+static uint8_t stream[4 * TEST_MAX_DATA];
+static int stream_len;
+static int failures;
+
+#define CHECK(cond, ...) do {                   \
+    if (!(cond)) {                              \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        failures++;                             \
+    }                                           \
+} while (0)
+
+// bit by bit on purpose, so a wrong table in ogg_page.c cannot agree with itself
+static uint32_t ref_crc(const uint8_t *p, int len)
+{
+    uint32_t crc = 0;
+    while (len--) {
+        crc ^= (uint32_t)*p++ << 24;
+        for (int i = 0; i < 8; i++) {
+            crc = crc & 0x80000000u ? (crc << 1) ^ 0x04C11DB7u : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void fill_packet(uint8_t *p, int len, int tag)
+{
+    for (int i = 0; i < len; i++) {
+        p[i] = (uint8_t)(tag * 31 + i);
+    }
+}
+
+static void append_page(ogg_page_writer_t *w, int64_t granule, int flags)
+{
+    const uint8_t *page;
+    int len = ogg_page_finish(w, granule, flags, &page);
+    if (stream_len + len > (int)sizeof(stream)) {
+        printf("FAIL: test stream buffer too small\n");
+        failures++;
+        return;
+    }
+    memcpy(stream + stream_len, page, len);
+    stream_len += len;
+}
+
+// parses one page at off, returns its length or -1 when it is malformed
+static int parse_page(const uint8_t *buf, int avail, parsed_page_t *pp)
+{
+    if (avail < 27 || memcmp(buf, "OggS", 4) != 0 || buf[4] != 0) {
+        return -1;
+    }
+    int nseg = buf[26];
+    if (avail < 27 + nseg) {
+        return -1;
+    }
+    int body = 0;
+    for (int i = 0; i < nseg; i++) {
+        body += buf[27 + i];
+    }
+    int len = 27 + nseg + body;
+    if (avail < len) {
+        return -1;
+    }
+    uint8_t copy[OGG_PAGE_MAX_HEADER + TEST_MAX_DATA];
+    memcpy(copy, buf, len);
+    memset(copy + 22, 0, 4);
+    uint32_t crc = rd32(buf + 22);
+    CHECK(crc == ref_crc(copy, len), "page crc %08x, expected %08x", (unsigned)crc, (unsigned)ref_crc(copy, len));
+
+    pp->flags = buf[5];
+    pp->granule = (int64_t)((uint64_t)rd32(buf + 6) | (uint64_t)rd32(buf + 10) << 32);
+    pp->serial = rd32(buf + 14);
+    pp->seq = rd32(buf + 18);
+    pp->packets = 0;
+    const uint8_t *data = buf + 27 + nseg;
+    int start = 0, plen = 0;
+    for (int i = 0; i < nseg; i++) {
+        plen += buf[27 + i];
+        // a lacing value below 255 ends the packet
+        if (buf[27 + i] < 255) {
+            if (pp->packets < TEST_MAX_PKTS) {
+                pp->data[pp->packets] = data + start;
+                pp->len[pp->packets] = plen;
+            }
+            pp->packets++;
+            start += plen;
+            plen = 0;
+        }
+    }
+    CHECK(plen == 0, "page %u ends inside a packet, the writer never continues one", (unsigned)pp->seq);
+    return len;
+}
+
+static void build_stream(void)
+{
+    ogg_page_writer_t w;
+    if (ogg_page_init(&w, TEST_SERIAL, TEST_MAX_DATA) != 0) {
+        printf("FAIL: no memory\n");
+        failures++;
+        return;
+    }
+    uint8_t pkt[TEST_MAX_DATA];
+    int n = ogg_opus_head(pkt, 1, TEST_PRE_SKIP, 16000);
+    ogg_page_add_packet(&w, pkt, n);
+    append_page(&w, 0, OGG_PAGE_BOS);
+    n = ogg_opus_tags(pkt, sizeof(pkt), "ogg_page_test");
+    ogg_page_add_packet(&w, pkt, n);
+    append_page(&w, 0, 0);
+
+    for (int i = 0; i < ARRAY_SIZE(packet_sizes); i++) {
+        CHECK(ogg_page_fits(&w, packet_sizes[i]), "packet %d of %d bytes should fit", i, packet_sizes[i]);
+        fill_packet(pkt, packet_sizes[i], i);
+        ogg_page_add_packet(&w, pkt, packet_sizes[i]);
+    }
+    CHECK(!ogg_page_fits(&w, TEST_MAX_DATA), "a packet past max_data fits");
+    append_page(&w, TEST_PRE_SKIP + TEST_FRAME * ARRAY_SIZE(packet_sizes), 0);
+    // an end of stream page with no packet, like the mux writes when the input stops on a boundary
+    append_page(&w, 12345, OGG_PAGE_EOS);
+    ogg_page_deinit(&w);
+}
+
+// a page takes 255 lacing values, empty packets use one each
+static void check_lacing_limit(void)
+{
+    ogg_page_writer_t w;
+    if (ogg_page_init(&w, TEST_SERIAL, 255 * 255) != 0) {
+        printf("FAIL: no memory\n");
+        failures++;
+        return;
+    }
+    uint8_t none = 0;
+    int added = 0;
+    while (ogg_page_fits(&w, 0) && added < 300) {
+        ogg_page_add_packet(&w, &none, 0);
+        added++;
+    }
+    CHECK(added == 255, "%d empty packets fit in a page, expected 255", added);
+    const uint8_t *page;
+    int len = ogg_page_finish(&w, 0, 0, &page);
+    CHECK(len == 27 + 255 && page[26] == 255, "full lacing page is %d bytes", len);
+    ogg_page_deinit(&w);
+}
+
+static void check_stream(void)
+{
+    parsed_page_t pages[TEST_MAX_PAGES];
+    int count = 0;
+    for (int off = 0; off < stream_len; count++) {
+        if (count == TEST_MAX_PAGES) {
+            printf("FAIL: more than %d pages\n", TEST_MAX_PAGES);
+            failures++;
+            return;
+        }
+        int len = parse_page(stream + off, stream_len - off, &pages[count]);
+        if (len < 0) {
+            printf("FAIL: malformed page at byte %d\n", off);
+            failures++;
+            return;
+        }
+        off += len;
+    }
+    CHECK(count == 4, "%d pages, expected 4", count);
+    if (count != 4) {
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        CHECK(pages[i].serial == TEST_SERIAL, "page %d serial %08x", i, (unsigned)pages[i].serial);
+        CHECK(pages[i].seq == (uint32_t)i, "page %d sequence %u", i, (unsigned)pages[i].seq);
+    }
+
+    parsed_page_t *p = &pages[0];
+    CHECK(p->flags == OGG_PAGE_BOS, "OpusHead page flags %02x", p->flags);
+    CHECK(p->packets == 1 && p->len[0] == 19, "OpusHead page holds %d packets", p->packets);
+    CHECK(p->granule == 0, "OpusHead granule %lld", (long long)p->granule);
+    if (p->packets == 1) {
+        const uint8_t *h = p->data[0];
+        CHECK(memcmp(h, "OpusHead", 8) == 0 && h[8] == 1 && h[9] == 1, "OpusHead magic, version or channels");
+        CHECK((h[10] | h[11] << 8) == TEST_PRE_SKIP, "pre-skip %d", h[10] | h[11] << 8);
+        CHECK(rd32(h + 12) == 16000, "input sample rate %u", (unsigned)rd32(h + 12));
+    }
+
+    p = &pages[1];
+    CHECK(p->flags == 0 && p->granule == 0, "OpusTags page flags %02x granule %lld", p->flags, (long long)p->granule);
+    CHECK(p->packets == 1 && memcmp(p->data[0], "OpusTags", 8) == 0, "OpusTags packet");
+
+    p = &pages[2];
+    CHECK(p->packets == ARRAY_SIZE(packet_sizes), "audio page holds %d packets", p->packets);
+    CHECK(p->granule == TEST_PRE_SKIP + TEST_FRAME * ARRAY_SIZE(packet_sizes), "audio granule %lld",
+          (long long)p->granule);
+    for (int i = 0; i < p->packets && i < ARRAY_SIZE(packet_sizes); i++) {
+        uint8_t expect[TEST_MAX_DATA];
+        fill_packet(expect, packet_sizes[i], i);
+        CHECK(p->len[i] == packet_sizes[i] && memcmp(p->data[i], expect, packet_sizes[i]) == 0,
+              "packet %d came back as %d bytes, sent %d", i, p->len[i], packet_sizes[i]);
+    }
+
+    p = &pages[3];
+    CHECK(p->flags == OGG_PAGE_EOS && p->packets == 0, "EOS page flags %02x, %d packets", p->flags, p->packets);
+    CHECK(p->granule == -1, "empty EOS page granule %lld, expected -1", (long long)p->granule);
+}
+
+int main(void)
+{
+    build_stream();
+    check_stream();
+    check_lacing_limit();
+    printf("%s: %d bytes in the stream, %d failures\n", failures ? "FAIL" : "PASS", stream_len, failures);
+    return failures ? 1 : 0;
+}
+#endif
\ No newline at end of file
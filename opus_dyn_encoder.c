@@ -0,0 +1,231 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "opus.h"
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "ringbuf.h"
+#include "soak_stats.h"
+#include "opus_dyn_encoder.h"
+
+static const char *TAG = "OPUS_DYN_ENCODER";
+
+#define OPUS_MAX_PACKET (1275)
+#define OPUS_PACKET_HEADER (2)
+
+typedef struct opus_dyn_encoder {
+    opus_dyn_encoder_cfg_t  cfg;
+    OpusEncoder             *enc;
+    int                     frame_bytes;
+    int                     filled;
+    unsigned char           *packet;
+    volatile int            want_bitrate;
+    volatile int            want_complexity;
+    volatile int            pre_skip;
+    opus_dyn_encoder_stats_t stats;
+} opus_dyn_encoder_t;
+
+static void _apply_settings(opus_dyn_encoder_t *o)
+{
+    int bitrate = o->want_bitrate;
+    int complexity = o->want_complexity;
+    if (bitrate != o->stats.bitrate) {
+        opus_encoder_ctl(o->enc, OPUS_SET_BITRATE(bitrate));
+        o->stats.bitrate = bitrate;
+    }
+    if (complexity != o->stats.complexity) {
+        opus_encoder_ctl(o->enc, OPUS_SET_COMPLEXITY(complexity));
+        o->stats.complexity = complexity;
+    }
+}
+
+static esp_err_t _opus_open(audio_element_handle_t self)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    if (o->enc) {
+        return ESP_OK;
+    }
+    int err = OPUS_OK;
+    o->enc = opus_encoder_create(o->cfg.sample_rate, o->cfg.channel, OPUS_APPLICATION_AUDIO, &err);
+    if (o->enc == NULL || err != OPUS_OK) {
+        ESP_LOGE(TAG, "opus_encoder_create failed, %s", opus_strerror(err));
+        return ESP_FAIL;
+    }
+    o->stats.bitrate = 0;
+    o->stats.complexity = -1;
+    _apply_settings(o);
+    o->filled = 0;
+    opus_int32 lookahead = 0;
+    if (opus_encoder_ctl(o->enc, OPUS_GET_LOOKAHEAD(&lookahead)) == OPUS_OK) {
+        o->pre_skip = lookahead * (48000 / o->cfg.sample_rate);
+    }
+
+    audio_element_info_t info = {0};
+    audio_element_getinfo(self, &info);
+    info.sample_rates = o->cfg.sample_rate;
+    info.channels = o->cfg.channel;
+    info.bits = 16;
+    info.bps = o->stats.bitrate;
+    info.codec_fmt = ESP_CODEC_TYPE_OPUS;
+    audio_element_setinfo(self, &info);
+    return ESP_OK;
+}
+
+static int _opus_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer + o->filled, o->frame_bytes - o->filled);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    o->filled += r_size;
+    if (o->filled < o->frame_bytes) {
+        return r_size;
+    }
+    o->filled = 0;
+    _apply_settings(o);
+
+    int hdr = o->cfg.packet_header ? OPUS_PACKET_HEADER : 0;
+    int64_t start = esp_timer_get_time();
+    int n = opus_encode(o->enc, (const opus_int16 *)in_buffer, o->frame_bytes / (2 * o->cfg.channel),
+                        o->packet + hdr, OPUS_MAX_PACKET);
+    int encode_us = esp_timer_get_time() - start;
+    o->stats.encode_us += encode_us;
+    soak_stats_record(SOAK_ENCODE_US, encode_us);
+    if (n < 0) {
+        ESP_LOGE(TAG, "opus_encode failed, %s", opus_strerror(n));
+        return AEL_IO_FAIL;
+    }
+    o->stats.frames++;
+    o->stats.bytes_out += n;
+    if (hdr) {
+        o->packet[0] = n & 0xFF;
+        o->packet[1] = n >> 8;
+    }
+    int w_size = audio_element_output(self, (char *)o->packet, n + hdr);
+    if (w_size > 0) {
+        audio_element_update_byte_pos(self, o->frame_bytes);
+    }
+    for (int i = 0; i < o->cfg.multi_out_num; i++) {
+        ringbuf_handle_t rb = audio_element_get_multi_output_ringbuf(self, i);
+        if (rb == NULL) {
+            continue;
+        }
+        // whole packet or nothing, a partial write would break the length prefix framing
+        if (rb_bytes_available(rb) >= n + hdr) {
+            rb_write(rb, (char *)o->packet, n + hdr, 0);
+        } else {
+            o->stats.multi_skipped++;
+        }
+    }
+    return w_size;
+}
+
+static esp_err_t _opus_close(audio_element_handle_t self)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    if (o->enc) {
+        opus_encoder_destroy(o->enc);
+        o->enc = NULL;
+    }
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        for (int i = 0; i < o->cfg.multi_out_num; i++) {
+            ringbuf_handle_t rb = audio_element_get_multi_output_ringbuf(self, i);
+            if (rb) {
+                rb_done_write(rb);
+            }
+        }
+        audio_element_report_info(self);
+        audio_element_set_byte_pos(self, 0);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _opus_destroy(audio_element_handle_t self)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    audio_free(o->packet);
+    audio_free(o);
+    return ESP_OK;
+}
+
+esp_err_t opus_dyn_encoder_set_bitrate(audio_element_handle_t self, int bitrate)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, o, return ESP_FAIL);
+    if (bitrate < 6000 || bitrate > 510000) {
+        ESP_LOGE(TAG, "Bitrate %d out of range", bitrate);
+        return ESP_FAIL;
+    }
+    o->want_bitrate = bitrate;
+    return ESP_OK;
+}
+
+esp_err_t opus_dyn_encoder_set_complexity(audio_element_handle_t self, int complexity)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, o, return ESP_FAIL);
+    if (complexity < 0 || complexity > 10) {
+        ESP_LOGE(TAG, "Complexity %d out of range", complexity);
+        return ESP_FAIL;
+    }
+    o->want_complexity = complexity;
+    return ESP_OK;
+}
+
+int opus_dyn_encoder_get_pre_skip(audio_element_handle_t self)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, o, return -1);
+    return o->pre_skip;
+}
+
+esp_err_t opus_dyn_encoder_get_stats(audio_element_handle_t self, opus_dyn_encoder_stats_t *stats)
+{
+    opus_dyn_encoder_t *o = (opus_dyn_encoder_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, o, return ESP_FAIL);
+    memcpy(stats, &o->stats, sizeof(*stats));
+    return ESP_OK;
+}
+
+audio_element_handle_t opus_dyn_encoder_init(opus_dyn_encoder_cfg_t *config)
+{
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    opus_dyn_encoder_t *o = audio_calloc(1, sizeof(opus_dyn_encoder_t));
+    AUDIO_MEM_CHECK(TAG, o, return NULL);
+    memcpy(&o->cfg, config, sizeof(opus_dyn_encoder_cfg_t));
+    o->frame_bytes = config->sample_rate / 1000 * config->frame_ms * config->channel * 2;
+    o->want_bitrate = config->bitrate;
+    o->want_complexity = config->complexity;
+    o->pre_skip = -1;
+    o->packet = audio_malloc(OPUS_PACKET_HEADER + OPUS_MAX_PACKET);
+    AUDIO_MEM_CHECK(TAG, o->packet, {
+        audio_free(o);
+        return NULL;
+    });
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _opus_open;
+    cfg.close = _opus_close;
+    cfg.process = _opus_process;
+    cfg.destroy = _opus_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.multi_out_rb_num = config->multi_out_num;
+    cfg.buffer_len = o->frame_bytes;
+    cfg.tag = "opus";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(o->packet);
+        audio_free(o);
+        return NULL;
+    });
+    audio_element_setdata(el, o);
+    return el;
+}
\ No newline at end of file
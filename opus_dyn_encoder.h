@@ -0,0 +1,114 @@
+#ifndef _OPUS_DYN_ENCODER_H_
+#define _OPUS_DYN_ENCODER_H_
+
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Opus encoder configuration
+ *
+ *          Same role as the ADF opus encoder, but built directly on libopus so bitrate
+ *          and complexity can be changed while the pipeline runs.
+ */
+typedef struct {
+    int     sample_rate;        /*!< Input sample rate, one of 8000/12000/16000/24000/48000 */
+    int     channel;            /*!< Input channels */
+    int     bitrate;            /*!< Initial bitrate in bps */
+    int     complexity;         /*!< Initial complexity, 0..10 */
+    int     frame_ms;           /*!< Frame duration, 10/20/40/60 */
+    bool    packet_header;      /*!< Prefix each packet with its 16 bit little endian length, needed by ogg_opus_mux */
+    int     multi_out_num;      /*!< Extra outputs, see audio_element_set_multi_output_ringbuf. The main output
+                                     blocks when full, extra outputs skip whole packets instead */
+    int     out_rb_size;        /*!< Output ringbuffer size */
+    int     task_stack;         /*!< Task stack size */
+    int     task_core;          /*!< Task running in core */
+    int     task_prio;          /*!< Task priority */
+} opus_dyn_encoder_cfg_t;
+
+/**
+ * @brief   Encoder counters
+ */
+typedef struct {
+    int     bitrate;            /*!< Bitrate currently applied */
+    int     complexity;         /*!< Complexity currently applied */
+    int64_t frames;             /*!< Frames encoded */
+    int64_t bytes_out;          /*!< Encoded bytes */
+    int64_t encode_us;          /*!< Time spent in opus_encode */
+    int64_t multi_skipped;      /*!< Packets an extra output had no room for, summed over outputs */
+} opus_dyn_encoder_stats_t;
+
+#define OPUS_DYN_ENCODER_TASK_STACK     (40 * 1024)
+#define OPUS_DYN_ENCODER_TASK_CORE      (0)
+#define OPUS_DYN_ENCODER_TASK_PRIO      (5)
+#define OPUS_DYN_ENCODER_RINGBUFFER_SIZE (2 * 1024)
+
+#define OPUS_DYN_ENCODER_CFG_DEFAULT() {                    \
+    .sample_rate = 16000,                                   \
+    .channel = 1,                                           \
+    .bitrate = 24000,                                       \
+    .complexity = 5,                                        \
+    .frame_ms = 20,                                         \
+    .packet_header = false,                                 \
+    .multi_out_num = 0,                                     \
+    .out_rb_size = OPUS_DYN_ENCODER_RINGBUFFER_SIZE,        \
+    .task_stack = OPUS_DYN_ENCODER_TASK_STACK,              \
+    .task_core = OPUS_DYN_ENCODER_TASK_CORE,                \
+    .task_prio = OPUS_DYN_ENCODER_TASK_PRIO,                \
+}
+
+/**
+ * @brief      Create an Opus encoder element
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL on failure
+ */
+audio_element_handle_t opus_dyn_encoder_init(opus_dyn_encoder_cfg_t *config);
+
+/**
+ * @brief      Change the bitrate, applied before the next frame
+ *
+ * @param      self     The encoder handle
+ * @param      bitrate  Bitrate in bps
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t opus_dyn_encoder_set_bitrate(audio_element_handle_t self, int bitrate);
+
+/**
+ * @brief      Change the complexity, applied before the next frame
+ *
+ * @param      self        The encoder handle
+ * @param      complexity  0..10
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t opus_dyn_encoder_set_complexity(audio_element_handle_t self, int complexity);
+
+/**
+ * @brief      Encoder lookahead as an Ogg Opus pre-skip, from OPUS_GET_LOOKAHEAD
+ *
+ * @param      self  The encoder handle
+ *
+ * @return     Samples at 48 kHz, -1 until the element has been opened
+ */
+int opus_dyn_encoder_get_pre_skip(audio_element_handle_t self);
+
+/**
+ * @brief      Read the encoder counters
+ *
+ * @param      self   The encoder handle
+ * @param      stats  Filled with the current values
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t opus_dyn_encoder_get_stats(audio_element_handle_t self, opus_dyn_encoder_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "sdkconfig.h"
 #include "audio_element.h"
@@ -14,9 +15,19 @@
 #include "esp_peripherals.h"
 #include "periph_sdcard.h"
 #include "periph_wifi.h"
-#include "fatfs_stream.h"
 #include "i2s_stream.h"
-#include "opus_encoder.h"
+#include "tone_stream.h"
+#include "energy_model.h"
+#include "fast_boot.h"
+#include "opus_dyn_encoder.h"
+#include "ogg_opus_mux.h"
+#include "duty_cycle.h"
+#include "seg_stream.h"
+#include "soak_stats.h"
+#include "ringbuf.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <malloc.h>
 #include <math.h>
 
@@ -25,23 +36,101 @@
 
 static const char *TAG = "ESPEAR";
 #define RECORD_TIME_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
+// 1: write a standard Ogg Opus file with page-batched writes, 0: the encoder's length prefixed packets,
+// one write each. Both use opus_dyn_encoder with the same settings, so the write batching benchmark
+// at the end compares only the writes
+#define OGG_MUX (1)
+#define OGG_PAGE_MS (1000)
+// Capture and encoding start before the sdcard is mounted, the i2s ringbuffer holds this much meanwhile
+#define BOOT_BUFFER_MS (1000)
+// 1: record RECORD_TIME_SECONDS, deep sleep DUTY_SLEEP_SECONDS, then wake and append to the same rec.opus
+#define DUTY_CYCLE_MODE (0)
+#define DUTY_SLEEP_SECONDS (60)
+// 1: record SOAK_HOURS into fixed size rec_0001.opus, rec_0002.opus, ... and report how performance drifts.
+// The segments split one stream, cat them back together to play it. That only holds after a clean stop,
+// a crash leaves full size preallocated segments with stale data at the end
+#define SOAK_MODE (0)
+#define SOAK_HOURS (8)
+#define SOAK_SEGMENT_MB (4)
+#define SOAK_BUCKET_SECONDS (600)
 
+#if SOAK_MODE
+#define RECORD_SECONDS (SOAK_HOURS * 3600)
+#else
+#define RECORD_SECONDS RECORD_TIME_SECONDS
+#endif
 
+#if DUTY_CYCLE_MODE && !OGG_MUX
+#error "DUTY_CYCLE_MODE appends Ogg pages, it needs OGG_MUX"
+#endif
 
-void app_main(void)
+#if DUTY_CYCLE_MODE && SOAK_MODE
+#error "DUTY_CYCLE_MODE and SOAK_MODE are separate experiments"
+#endif
+
+#if !SOAK_MODE
+#define REC_PATH (OGG_MUX ? "/sdcard/rec.opus" : "/sdcard/rec.opu")
+static int rec_fd = -1;
+static int64_t rec_writes;
+static int64_t rec_bytes;
+static int64_t rec_write_us;
+
+// The last element writes the recording through this instead of a fatfs_stream, so every write()
+// the file gets is counted; fatfs_stream would re-chunk them by its own ringbuffer reads. It also
+// lets a duty cycle wake append, fatfs_stream truncates on open
+static audio_element_err_t cb_write(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
 {
-    esp_log_level_set("*", ESP_LOG_WARN);
-    esp_log_level_set(TAG, ESP_LOG_INFO);
+    int64_t start = esp_timer_get_time();
+    int n = write(rec_fd, buffer, len);
+    rec_write_us += esp_timer_get_time() - start;
+    if (n != len) {
+        return AEL_IO_FAIL;
+    }
+    rec_writes++;
+    rec_bytes += n;
+    // there is no fatfs writer to watch, only the first call counts
+    fast_boot_mark(FAST_BOOT_FIRST_WRITE);
+    return n;
+}
+
+static esp_err_t open_recording(bool append)
+{
+    rec_fd = open(REC_PATH, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+    if (rec_fd < 0) {
+        ESP_LOGE(TAG, "Cannot open %s", REC_PATH);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+#endif
+
+#if DUTY_CYCLE_MODE
+static bool resume_recording(duty_cycle_state_t *duty, audio_element_handle_t ogg_mux)
+{
+    struct stat st;
+    bool append = duty_cycle_is_warm() && stat(REC_PATH, &st) == 0 && st.st_size == duty->file_size;
+    if (duty_cycle_is_warm() && !append) {
+        ESP_LOGW(TAG, "[ * ] %s is not what the last cycle left, starting a new recording", REC_PATH);
+    }
+    ogg_opus_mux_set_resume(ogg_mux, append, duty->ogg_next_seq, duty->ogg_granule);
+    return append;
+}
+#endif
 
-    audio_pipeline_handle_t pipeline;
-    audio_element_handle_t i2s_stream_reader, opus_encoder, fatfs_stream_writer;
-    
-    ESP_LOGI(TAG, "[ 1 ] Mount sdcard");
-    esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
-    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
-    audio_board_sdcard_init(set, SD_MODE_1_LINE);
 
-    ESP_LOGI(TAG, "[ 2 ] Start codec chip");
+
+#if !TEST_SIGNAL_SOURCE
+static esp_err_t start_codec(void *arg)
+{
+#if DUTY_CYCLE_MODE
+    // straight to line in, board init followed by a re-init configures the codec twice on every wake
+    audio_hal_codec_config_t duty_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    duty_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    audio_hal_handle_t hal = audio_hal_init(&duty_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+    esp_err_t ret = audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#else
     audio_board_handle_t board_handle = audio_board_init();
     
     // change input to aux in
@@ -50,38 +139,114 @@ void app_main(void)
     audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
     board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
 
-    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+    esp_err_t ret = audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#endif
+    if (ret == ESP_OK) {
+        fast_boot_mark(FAST_BOOT_CODEC_READY);
+    }
+    return ret;
+}
+#endif
+
+void app_main(void)
+{
+    fast_boot_mark(FAST_BOOT_APP_MAIN);
+#if DUTY_CYCLE_MODE
+    duty_cycle_state_t *duty = duty_cycle_begin();
+#endif
+    esp_log_level_set("*", ESP_LOG_WARN);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    audio_pipeline_handle_t pipeline;
+    audio_element_handle_t i2s_stream_reader, opus_encoder, fatfs_stream_writer = NULL, ogg_mux = NULL;
+    
+    ESP_LOGI(TAG, "[ 1 ] Mount sdcard in the background");
+    esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
+    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
+    fast_boot_step_handle_t sd_step = fast_boot_step_start("boot_sd", fast_boot_sdcard_step, set);
+
+#if !TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[ 2 ] Start codec chip in the background");
+    fast_boot_step_handle_t codec_step = fast_boot_step_start("boot_codec", start_codec, NULL);
+#endif
 
     ESP_LOGI(TAG, "[2.0] Create audio pipeline for listening");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
     mem_assert(pipeline);
 
-    ESP_LOGI(TAG, "[2.1] Create fatfs stream to write data to sdcard");
-    fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
-    fatfs_cfg.type = AUDIO_STREAM_WRITER;
-    fatfs_stream_writer = fatfs_stream_init(&fatfs_cfg);
+#if SOAK_MODE
+    ESP_LOGI(TAG, "[2.1] Create segment stream to write %d MB files to sdcard", SOAK_SEGMENT_MB);
+    seg_stream_cfg_t seg_cfg = SEG_STREAM_CFG_DEFAULT();
+    seg_cfg.path_fmt = OGG_MUX ? "/sdcard/rec_%04d.opus" : "/sdcard/rec_%04d.opu";
+    seg_cfg.segment_size = SOAK_SEGMENT_MB * 1024 * 1024;
+    fatfs_stream_writer = seg_stream_init(&seg_cfg);
+#else
+    // the last element writes the file itself, see cb_write
+#endif
 
     ESP_LOGI(TAG, "[2.2] Create opus encoder");
-    opus_encoder_cfg_t opus_cfg = DEFAULT_OPUS_ENCODER_CONFIG();
-    opus_encoder = encoder_opus_init(&opus_cfg);
+    opus_dyn_encoder_cfg_t opus_cfg = OPUS_DYN_ENCODER_CFG_DEFAULT();
+    opus_cfg.packet_header = true;
+    opus_encoder = opus_dyn_encoder_init(&opus_cfg);
+#if OGG_MUX
+    ESP_LOGI(TAG, "[2.2] Create ogg muxer");
+    ogg_opus_mux_cfg_t ogg_cfg = OGG_OPUS_MUX_CFG_DEFAULT();
+    ogg_cfg.input_sample_rate = opus_cfg.sample_rate;
+    ogg_cfg.channels = opus_cfg.channel;
+    ogg_cfg.page_ms = OGG_PAGE_MS;
+    ogg_cfg.encoder = opus_encoder;
+#if DUTY_CYCLE_MODE
+    // the next wake continues this stream, so no end of stream page
+    ogg_cfg.serial = duty->ogg_serial;
+    ogg_cfg.eos = false;
+#endif
+    ogg_mux = ogg_opus_mux_init(&ogg_cfg);
+#endif
 
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.3] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = 16000;
+    tone_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
     ESP_LOGI(TAG, "[2.3] Create i2s stream to read audio data from codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
     i2s_cfg.std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
     i2s_cfg.type = AUDIO_STREAM_READER;
     i2s_cfg.std_cfg.clk_cfg.sample_rate_hz=16000;
+    i2s_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
     i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
 
     ESP_LOGI(TAG, "[2.3] Register all elements to audio pipeline");
     audio_pipeline_register(pipeline, i2s_stream_reader, "i2s");
     audio_pipeline_register(pipeline, opus_encoder, "enc");
+#if OGG_MUX
+    audio_pipeline_register(pipeline, ogg_mux, "ogg");
+#endif
+#if SOAK_MODE
     audio_pipeline_register(pipeline, fatfs_stream_writer, "fat");
+#endif
 
     ESP_LOGI(TAG, "[2.4] Link it together");
-    const char *link_tag_main[3] = {"i2s", "enc", "fat"};
+#if SOAK_MODE && OGG_MUX
+    const char *link_tag_main[4] = {"i2s", "enc", "ogg", "fat"};
+    audio_pipeline_link(pipeline, &link_tag_main[0], 4);
+#elif SOAK_MODE || OGG_MUX
+    const char *link_tag_main[3] = {"i2s", "enc", SOAK_MODE ? "fat" : "ogg"};
     audio_pipeline_link(pipeline, &link_tag_main[0], 3);
+#else
+    const char *link_tag_main[2] = {"i2s", "enc"};
+    audio_pipeline_link(pipeline, &link_tag_main[0], 2);
+#endif
+#if !SOAK_MODE
+    audio_element_handle_t sink = OGG_MUX ? ogg_mux : opus_encoder;
+    audio_element_set_write_cb(sink, cb_write, NULL);
+#else
+    audio_element_handle_t sink = fatfs_stream_writer;
 
     ESP_LOGI(TAG, "[2.5] Set music info to fatfs");
     audio_element_info_t music_info = {0};
@@ -89,7 +254,7 @@ void app_main(void)
     ESP_LOGI(TAG, "[ * ] Save the recording info to the fatfs stream writer, sample_rates=%d, bits=%d, ch=%d",
                 music_info.sample_rates, music_info.bits, music_info.channels);
     audio_element_setinfo(fatfs_stream_writer, &music_info);
-    audio_element_set_uri(fatfs_stream_writer, "/sdcard/rec.opu");
+#endif
 
 
     ESP_LOGI(TAG, "[ 3 ] Set up  event listener");
@@ -102,28 +267,78 @@ void app_main(void)
     ESP_LOGI(TAG, "[3.2] Listening event from peripherals");
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(set), evt);
 
-    ESP_LOGI(TAG, "[ 4 ] Start audio_pipeline");
+    ESP_LOGI(TAG, "[ 4 ] Start capture, the writer follows once the sdcard is mounted");
+    fast_boot_mark(FAST_BOOT_PIPELINE_READY);
+#if !TEST_SIGNAL_SOURCE
+    if (fast_boot_step_wait(codec_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] Codec did not start, stop");
+        fast_boot_step_wait(sd_step);
+        goto _pipeline_exit;
+    }
+#endif
+    fast_boot_watch(i2s_stream_reader, FAST_BOOT_FIRST_SAMPLE);
+#if SOAK_MODE
+    fast_boot_watch(fatfs_stream_writer, FAST_BOOT_FIRST_WRITE);
+#endif
+    energy_model_start();
+#if SOAK_MODE
+    soak_stats_cfg_t soak_cfg = SOAK_STATS_CFG_DEFAULT();
+    soak_cfg.bucket_seconds = SOAK_BUCKET_SECONDS;
+    soak_stats_start(&soak_cfg);
+    ringbuf_handle_t capture_rb = audio_element_get_output_ringbuf(i2s_stream_reader);
+#endif
+    audio_element_run(i2s_stream_reader);
+    audio_element_resume(i2s_stream_reader, 0, 2000 / portTICK_PERIOD_MS);
+    if (fast_boot_step_wait(sd_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] No sdcard, stop capture");
+        audio_element_stop(i2s_stream_reader);
+        audio_element_wait_for_stop(i2s_stream_reader);
+        goto _pipeline_exit;
+    }
+#if DUTY_CYCLE_MODE
+    esp_err_t rec_ret = open_recording(resume_recording(duty, ogg_mux));
+#elif !SOAK_MODE
+    esp_err_t rec_ret = open_recording(false);
+#endif
+#if !SOAK_MODE
+    if (rec_ret != ESP_OK) {
+        audio_element_stop(i2s_stream_reader);
+        audio_element_wait_for_stop(i2s_stream_reader);
+        goto _pipeline_exit;
+    }
+#endif
+    // already running elements are left as they are
     audio_pipeline_run(pipeline);
 
-    ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_TIME_SECONDS);
+    ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_SECONDS);
     int second_recorded = 0;
     while (1) {
         audio_event_iface_msg_t msg;
         if (audio_event_iface_listen(evt, &msg, 1) != ESP_OK) {
+#if SOAK_MODE
+            soak_stats_record(SOAK_RB_FILL, rb_bytes_filled(capture_rb));
+#endif
             audio_element_info_t info;
             audio_element_getinfo(i2s_stream_reader, &info);
             int new_dur = info.byte_pos / (info.channels*(info.bits/8)*info.sample_rates);
             if(new_dur > second_recorded){
                 second_recorded = new_dur;
+#if SOAK_MODE
+                soak_stats_tick();
+                if (second_recorded % 60 == 0) {
+                    ESP_LOGI(TAG, "[ * ] Recording ... %d min", second_recorded / 60);
+                }
+#else
                 ESP_LOGI(TAG, "[ * ] Recording ... %d", second_recorded);
-                if (second_recorded >= RECORD_TIME_SECONDS) {
+#endif
+                if (second_recorded >= RECORD_SECONDS) {
                     audio_element_set_ringbuf_done(i2s_stream_reader);
                 }
             }
             continue;
         }
-        /* Stop when the last pipeline element (fatfs_stream_writer in this case) receives stop event */
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) fatfs_stream_writer
+        /* Stop when the last pipeline element receives stop event */
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) sink
             && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
             && (((int)msg.data == AEL_STATUS_STATE_STOPPED) || ((int)msg.data == AEL_STATUS_STATE_FINISHED)
                 || ((int)msg.data == AEL_STATUS_ERROR_OPEN))) {
@@ -131,6 +346,49 @@ void app_main(void)
             break;
         }
     }
+    audio_element_info_t fatfs_info = {0};
+#if SOAK_MODE
+    audio_element_getinfo(fatfs_stream_writer, &fatfs_info);
+#else
+    fatfs_info.byte_pos = rec_bytes;
+    close(rec_fd);
+#endif
+#if DUTY_CYCLE_MODE
+    ogg_opus_mux_stats_t cycle_stats;
+    ogg_opus_mux_get_stats(ogg_mux, &cycle_stats);
+    struct stat rec_st;
+    duty->file_size = stat(REC_PATH, &rec_st) == 0 ? rec_st.st_size : 0;
+    duty->ogg_next_seq = cycle_stats.next_seq;
+    duty->ogg_granule = cycle_stats.granule;
+#endif
+    // element tasks are named after the tag, without a fatfs writer the sink element does the writes
+    int64_t writer_us = energy_model_task_runtime_us(audio_element_get_tag(sink));
+    energy_model_add_sd(fatfs_info.byte_pos, writer_us);
+    energy_model_report("opus_sd", second_recorded);
+    fast_boot_report("opus_sd");
+#if SOAK_MODE
+    soak_stats_report("opus_sd");
+#endif
+
+    // write batching benchmark, compare a run with OGG_MUX 0 and 1
+#if SOAK_MODE
+    ESP_LOGI(TAG, "[ * ] fatfs: %lld bytes, writer task %lld us", fatfs_info.byte_pos, writer_us);
+#else
+    ESP_LOGI(TAG, "[ * ] %s: %lld bytes in %lld write() calls, %lld us in write(), writer task %lld us", REC_PATH,
+             rec_bytes, rec_writes, rec_write_us, writer_us);
+#endif
+    opus_dyn_encoder_stats_t enc_stats;
+    opus_dyn_encoder_get_stats(opus_encoder, &enc_stats);
+    ESP_LOGI(TAG, "[ * ] encoder: %lld packets, %lld bytes, %lld us", enc_stats.frames, enc_stats.bytes_out,
+             enc_stats.encode_us);
+#if OGG_MUX
+    ogg_opus_mux_stats_t ogg_stats;
+    ogg_opus_mux_get_stats(ogg_mux, &ogg_stats);
+    ESP_LOGI(TAG, "[ * ] ogg: %lld packets -> %lld pages, %lld bytes, mux %lld us", ogg_stats.packets, ogg_stats.pages,
+             ogg_stats.bytes_out, ogg_stats.mux_us);
+#endif
+
+_pipeline_exit:
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
     audio_pipeline_stop(pipeline);
     audio_pipeline_wait_for_stop(pipeline);
@@ -139,7 +397,12 @@ void app_main(void)
 
     audio_pipeline_unregister(pipeline, i2s_stream_reader);
     audio_pipeline_unregister(pipeline, opus_encoder);
-    audio_pipeline_unregister(pipeline, fatfs_stream_writer);
+    if (fatfs_stream_writer) {
+        audio_pipeline_unregister(pipeline, fatfs_stream_writer);
+    }
+    if (ogg_mux) {
+        audio_pipeline_unregister(pipeline, ogg_mux);
+    }
 
     
     /* Terminal the pipeline before removing the listener */
@@ -156,7 +419,21 @@ void app_main(void)
     audio_pipeline_deinit(pipeline);
     audio_element_deinit(i2s_stream_reader);
     audio_element_deinit(opus_encoder);
-    audio_element_deinit(fatfs_stream_writer);
+    if (fatfs_stream_writer) {
+        audio_element_deinit(fatfs_stream_writer);
+    }
+    if (ogg_mux) {
+        audio_element_deinit(ogg_mux);
+    }
 
     esp_periph_set_destroy(set);
+#if SOAK_MODE
+    soak_stats_stop();
+#endif
+
+#if DUTY_CYCLE_MODE
+    duty_cycle_cfg_t duty_cfg = DUTY_CYCLE_CFG_DEFAULT();
+    duty_cfg.sleep_seconds = DUTY_SLEEP_SECONDS;
+    duty_cycle_sleep(&duty_cfg, "opus_sd");
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_system.h"
+#include "nvs_flash.h"
+
+#include "sdkconfig.h"
+#include "audio_element.h"
+#include "audio_pipeline.h"
+#include "audio_event_iface.h"
+#include "audio_common.h"
+#include "audio_sys.h"
+#include "board.h"
+#include "esp_peripherals.h"
+#include "periph_wifi.h"
+#include "periph_sdcard.h"
+#include "fatfs_stream.h"
+#include "i2s_stream.h"
+#include "tone_stream.h"
+#include "energy_model.h"
+#include "fast_boot.h"
+#include "opus_dyn_encoder.h"
+#include "ogg_opus_mux.h"
+#include "ringbuf.h"
+#include "spool_stream.h"
+#include "esp_netif.h"
+
+
+static const char *TAG = "ESPEAR";
+#define RECORD_TIME_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
+// 1: benchmark mode, i2s fans raw PCM out to a second encoder instead of sharing one
+#define DUAL_ENCODER (0)
+// The archive gets long pages for fewer card writes, the stream short ones for latency
+#define OGG_PAGE_MS_SD (1000)
+#define OGG_PAGE_MS_NET (100)
+// Fan-out ringbuffer in front of the network branch, PCM needs more room than packets
+#define NET_RB_SIZE (DUAL_ENCODER ? 16 * 1024 : 8 * 1024)
+// Capture starts before the sdcard is mounted, the i2s ringbuffer holds this much meanwhile
+#define BOOT_BUFFER_MS (1000)
+
+#if DUAL_ENCODER && TEST_SIGNAL_SOURCE
+#error "DUAL_ENCODER needs the i2s multi output, the test signal source has none"
+#endif
+
+
+#if !TEST_SIGNAL_SOURCE
+static esp_err_t start_codec(void *arg)
+{
+    audio_board_handle_t board_handle = audio_board_init();
+
+    // change input to aux in
+    audio_hal_deinit(board_handle->audio_hal);
+    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+
+    esp_err_t ret = audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+    if (ret == ESP_OK) {
+        fast_boot_mark(FAST_BOOT_CODEC_READY);
+    }
+    return ret;
+}
+#endif
+
+void app_main(void)
+{
+    fast_boot_mark(FAST_BOOT_APP_MAIN);
+    esp_log_level_set("*", ESP_LOG_WARN);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        // NVS partition was truncated and needs to be erased
+        // Retry nvs_flash_init
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+    ESP_ERROR_CHECK(esp_netif_init());
+
+    audio_pipeline_handle_t pipeline_sd, pipeline_net;
+    audio_element_handle_t i2s_stream_reader, opus_encoder, ogg_sd, fatfs_stream_writer;
+    audio_element_handle_t opus_encoder_net = NULL, ogg_net, spool_stream_writer;
+
+    ESP_LOGI(TAG, "[ 1 ] Start WIFI, the spool stream connects once the link is up");
+    esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
+    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
+    periph_wifi_cfg_t wifi_cfg = {
+        .wifi_config.sta.ssid = CONFIG_WIFI_SSID,
+        .wifi_config.sta.password = CONFIG_WIFI_PASSWORD,
+    };
+    esp_periph_handle_t wifi_handle = periph_wifi_init(&wifi_cfg);
+
+    esp_periph_start(set, wifi_handle);
+    fast_boot_watch_wifi(wifi_handle);
+
+    // from here on only the mount step adds to the peripheral set
+    ESP_LOGI(TAG, "[1.1] Mount sdcard for the archive and the spool in the background");
+    fast_boot_step_handle_t sd_step = fast_boot_step_start("boot_sd", fast_boot_sdcard_step, set);
+
+#if !TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[ 2 ] Start codec chip in the background");
+    fast_boot_step_handle_t codec_step = fast_boot_step_start("boot_codec", start_codec, NULL);
+#endif
+
+    // baseline before any pipeline, element or ringbuffer exists, both configurations measure from here;
+    // the sdcard mount and the wifi connect still running in the background are the same for both
+    uint32_t heap_before = esp_get_free_heap_size();
+    ESP_LOGI(TAG, "[2.0] Create one pipeline per sink, they share the capture");
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    pipeline_sd = audio_pipeline_init(&pipeline_cfg);
+    pipeline_net = audio_pipeline_init(&pipeline_cfg);
+    mem_assert(pipeline_sd);
+    mem_assert(pipeline_net);
+
+    ESP_LOGI(TAG, "[2.1] Create fatfs stream to write data to sdcard");
+    fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
+    fatfs_cfg.type = AUDIO_STREAM_WRITER;
+    fatfs_stream_writer = fatfs_stream_init(&fatfs_cfg);
+
+    ESP_LOGI(TAG, "[2.2] Create spool stream for the network");
+    spool_stream_cfg_t spool_cfg = SPOOL_STREAM_CFG_DEFAULT();
+    spool_cfg.host = "192.168.137.1";
+    spool_cfg.port = 8000;
+    spool_stream_writer = spool_stream_init(&spool_cfg);
+
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.3] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = 16000;
+    tone_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
+    ESP_LOGI(TAG, "[2.3] Create i2s stream to read audio data from codec chip");
+    i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
+    i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
+    i2s_cfg.std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+    i2s_cfg.type = AUDIO_STREAM_READER;
+    i2s_cfg.std_cfg.clk_cfg.sample_rate_hz=16000;
+    i2s_cfg.multi_out_num = DUAL_ENCODER;
+    i2s_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
+    i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
+
+    ESP_LOGI(TAG, "[2.4] Create opus encoder and ogg muxers");
+    opus_dyn_encoder_cfg_t opus_cfg = OPUS_DYN_ENCODER_CFG_DEFAULT();
+    opus_cfg.packet_header = true;
+    // the network copy is taken from the encoder output, whole packets, skipped when its ringbuffer is full
+    opus_cfg.multi_out_num = DUAL_ENCODER ? 0 : 1;
+    opus_encoder = opus_dyn_encoder_init(&opus_cfg);
+#if DUAL_ENCODER
+    opus_encoder_net = opus_dyn_encoder_init(&opus_cfg);
+#endif
+    ogg_opus_mux_cfg_t ogg_cfg = OGG_OPUS_MUX_CFG_DEFAULT();
+    ogg_cfg.input_sample_rate = opus_cfg.sample_rate;
+    ogg_cfg.channels = opus_cfg.channel;
+    ogg_cfg.page_ms = OGG_PAGE_MS_SD;
+    ogg_cfg.encoder = opus_encoder;
+    ogg_sd = ogg_opus_mux_init(&ogg_cfg);
+    ogg_cfg.page_ms = OGG_PAGE_MS_NET;
+#if DUAL_ENCODER
+    ogg_cfg.encoder = opus_encoder_net;
+#endif
+    ogg_net = ogg_opus_mux_init(&ogg_cfg);
+
+    ESP_LOGI(TAG, "[2.5] Register and link, sd: i2s -> enc -> ogg -> fat, net: [rb] -> ogg -> spool");
+    audio_pipeline_register(pipeline_sd, i2s_stream_reader, "i2s");
+    audio_pipeline_register(pipeline_sd, opus_encoder, "enc");
+    audio_pipeline_register(pipeline_sd, ogg_sd, "ogg");
+    audio_pipeline_register(pipeline_sd, fatfs_stream_writer, "fat");
+    const char *link_tag_sd[4] = {"i2s", "enc", "ogg", "fat"};
+    audio_pipeline_link(pipeline_sd, &link_tag_sd[0], 4);
+
+    audio_pipeline_register(pipeline_net, ogg_net, "ogg_net");
+    audio_pipeline_register(pipeline_net, spool_stream_writer, "spool");
+#if DUAL_ENCODER
+    audio_pipeline_register(pipeline_net, opus_encoder_net, "enc_net");
+    const char *link_tag_net[3] = {"enc_net", "ogg_net", "spool"};
+    audio_pipeline_link(pipeline_net, &link_tag_net[0], 3);
+    audio_element_handle_t net_head = opus_encoder_net, fan_out = i2s_stream_reader;
+#else
+    const char *link_tag_net[2] = {"ogg_net", "spool"};
+    audio_pipeline_link(pipeline_net, &link_tag_net[0], 2);
+    audio_element_handle_t net_head = ogg_net, fan_out = opus_encoder;
+#endif
+
+    ESP_LOGI(TAG, "[2.6] Connect the network branch to the fan-out");
+    ringbuf_handle_t net_rb = rb_create(NET_RB_SIZE, 1);
+    mem_assert(net_rb);
+    audio_element_set_input_ringbuf(net_head, net_rb);
+    audio_element_set_multi_output_ringbuf(fan_out, net_rb, 0);
+
+    audio_element_info_t music_info = {0};
+    audio_element_getinfo(i2s_stream_reader, &music_info);
+    audio_element_setinfo(fatfs_stream_writer, &music_info);
+    audio_element_set_uri(fatfs_stream_writer, "/sdcard/rec.opus");
+
+    ESP_LOGI(TAG, "[ 3 ] Set up  event listener");
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+
+    ESP_LOGI(TAG, "[3.1] Listening event from both pipelines");
+    audio_pipeline_set_listener(pipeline_sd, evt);
+    audio_pipeline_set_listener(pipeline_net, evt);
+
+    ESP_LOGI(TAG, "[3.2] Listening event from peripherals");
+    audio_event_iface_set_listener(esp_periph_set_get_event_iface(set), evt);
+
+    ESP_LOGI(TAG, "[ 4 ] Start capture, both sinks follow once the sdcard is mounted");
+    fast_boot_mark(FAST_BOOT_PIPELINE_READY);
+#if !TEST_SIGNAL_SOURCE
+    if (fast_boot_step_wait(codec_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] Codec did not start, stop");
+        fast_boot_step_wait(sd_step);
+        goto _pipeline_exit;
+    }
+#endif
+    fast_boot_watch(i2s_stream_reader, FAST_BOOT_FIRST_SAMPLE);
+    fast_boot_watch(fatfs_stream_writer, FAST_BOOT_FIRST_WRITE);
+    energy_model_start();
+    audio_element_run(i2s_stream_reader);
+    audio_element_resume(i2s_stream_reader, 0, 2000 / portTICK_PERIOD_MS);
+    if (fast_boot_step_wait(sd_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] No sdcard, stop capture");
+        audio_element_stop(i2s_stream_reader);
+        audio_element_wait_for_stop(i2s_stream_reader);
+        goto _pipeline_exit;
+    }
+    // already running elements are left as they are
+    audio_pipeline_run(pipeline_net);
+    audio_pipeline_run(pipeline_sd);
+
+    ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_TIME_SECONDS);
+    int second_recorded = 0;
+    bool sd_done = false, net_done = false;
+    uint32_t heap_min = esp_get_free_heap_size();
+    while (!sd_done || !net_done) {
+        audio_event_iface_msg_t msg;
+        if (audio_event_iface_listen(evt, &msg, 1) != ESP_OK) {
+            audio_element_info_t info;
+            audio_element_getinfo(i2s_stream_reader, &info);
+            int new_dur = info.byte_pos / (info.channels*(info.bits/8)*info.sample_rates);
+            if(new_dur > second_recorded){
+                second_recorded = new_dur;
+                uint32_t heap_now = esp_get_free_heap_size();
+                if (heap_now < heap_min) {
+                    heap_min = heap_now;
+                }
+                spool_stream_stats_t spool_stats;
+                spool_stream_get_stats(spool_stream_writer, &spool_stats);
+                ESP_LOGI(TAG, "[ * ] Recording ... %d, link %s, spool depth %d, fan-out fill %d/%d", second_recorded,
+                         spool_stats.connected ? "up" : "down", spool_stats.depth,
+                         rb_bytes_filled(net_rb), rb_get_size(net_rb));
+                if (second_recorded >= RECORD_TIME_SECONDS) {
+                    audio_element_set_ringbuf_done(i2s_stream_reader);
+                }
+            }
+            continue;
+        }
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
+            && (((int)msg.data == AEL_STATUS_STATE_STOPPED) || ((int)msg.data == AEL_STATUS_STATE_FINISHED)
+                || ((int)msg.data == AEL_STATUS_ERROR_OPEN))) {
+            if (msg.source == (void *) fatfs_stream_writer && !sd_done) {
+                ESP_LOGW(TAG, "[ * ] Archive finished");
+                sd_done = true;
+                // the fan-out source is done too, make sure the network branch sees the end
+                rb_done_write(net_rb);
+            } else if (msg.source == (void *) spool_stream_writer && !net_done) {
+                ESP_LOGW(TAG, "[ * ] Stream finished");
+                net_done = true;
+            }
+        }
+    }
+
+    audio_element_info_t fatfs_info;
+    audio_element_getinfo(fatfs_stream_writer, &fatfs_info);
+    spool_stream_stats_t spool_stats;
+    spool_stream_get_stats(spool_stream_writer, &spool_stats);
+    opus_dyn_encoder_stats_t enc_stats;
+    opus_dyn_encoder_get_stats(opus_encoder, &enc_stats);
+    ESP_LOGI(TAG, "[ * ] Archive: %lld bytes, stream: %lld bytes acknowledged, %lld packets skipped at the fan-out",
+             fatfs_info.byte_pos, spool_stats.bytes_acked, enc_stats.multi_skipped);
+    ESP_LOGI(TAG, "[ * ] %s: %d bytes heap taken at most by the sink pipelines, minimum free %d while running, "
+             "%d since boot, encoding %lld us", DUAL_ENCODER ? "Two encoders" : "Shared encoder",
+             (int)(heap_before - heap_min), (int)heap_min, (int)esp_get_minimum_free_heap_size(), enc_stats.encode_us);
+#if DUAL_ENCODER
+    opus_dyn_encoder_get_stats(opus_encoder_net, &enc_stats);
+    ESP_LOGI(TAG, "[ * ] Second encoder: %lld us encoding", enc_stats.encode_us);
+#endif
+
+    // spooled data is written to the sdcard once and read back once
+    energy_model_add_sd(fatfs_info.byte_pos + spool_stats.bytes_spooled * 2,
+                        energy_model_task_runtime_us(audio_element_get_tag(fatfs_stream_writer)));
+    energy_model_add_wifi(spool_stats.bytes_sent);
+    energy_model_report(DUAL_ENCODER ? "opus_sd_wifi_dual" : "opus_sd_wifi", second_recorded);
+    fast_boot_mark_at(FAST_BOOT_FIRST_SEND, spool_stats.first_send_us);
+    fast_boot_report(DUAL_ENCODER ? "opus_sd_wifi_dual" : "opus_sd_wifi");
+
+_pipeline_exit:
+    ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
+    audio_pipeline_stop(pipeline_sd);
+    audio_pipeline_stop(pipeline_net);
+    audio_pipeline_wait_for_stop(pipeline_sd);
+    audio_pipeline_wait_for_stop(pipeline_net);
+    audio_pipeline_terminate(pipeline_sd);
+    audio_pipeline_terminate(pipeline_net);
+
+    audio_pipeline_unregister(pipeline_sd, i2s_stream_reader);
+    audio_pipeline_unregister(pipeline_sd, opus_encoder);
+    audio_pipeline_unregister(pipeline_sd, ogg_sd);
+    audio_pipeline_unregister(pipeline_sd, fatfs_stream_writer);
+    audio_pipeline_unregister(pipeline_net, ogg_net);
+    audio_pipeline_unregister(pipeline_net, spool_stream_writer);
+    if (opus_encoder_net) {
+        audio_pipeline_unregister(pipeline_net, opus_encoder_net);
+    }
+
+    /* Terminal the pipeline before removing the listener */
+    audio_pipeline_remove_listener(pipeline_sd);
+    audio_pipeline_remove_listener(pipeline_net);
+
+    /* Stop all periph before removing the listener */
+    esp_periph_set_stop_all(set);
+    audio_event_iface_remove_listener(esp_periph_set_get_event_iface(set), evt);
+
+    /* Make sure audio_pipeline_remove_listener & audio_event_iface_remove_listener are called before destroying event_iface */
+    audio_event_iface_destroy(evt);
+
+    /* Release all resources */
+    audio_pipeline_deinit(pipeline_sd);
+    audio_pipeline_deinit(pipeline_net);
+    audio_element_deinit(i2s_stream_reader);
+    audio_element_deinit(opus_encoder);
+    audio_element_deinit(ogg_sd);
+    audio_element_deinit(fatfs_stream_writer);
+    audio_element_deinit(ogg_net);
+    audio_element_deinit(spool_stream_writer);
+    if (opus_encoder_net) {
+        audio_element_deinit(opus_encoder_net);
+    }
+    /* The fan-out ringbuffer is not owned by either pipeline */
+    rb_destroy(net_rb);
+
+    esp_periph_set_destroy(set);
+}
\ No newline at end of file
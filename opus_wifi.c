@@ -4,6 +4,7 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "sdkconfig.h"
@@ -15,18 +16,177 @@
 #include "board.h"
 #include "esp_peripherals.h"
 #include "periph_wifi.h"
+#include "periph_sdcard.h"
 #include "i2s_stream.h"
-#include "opus_encoder.h"
-#include "tcp_client_stream.h"
+#include "tone_stream.h"
+#include "energy_model.h"
+#include "fast_boot.h"
+#include "opus_dyn_encoder.h"
+#include "ogg_opus_mux.h"
+#include "ringbuf.h"
+#include "spool_stream.h"
+#include "duty_cycle.h"
 #include "esp_netif.h"
 
 
 static const char *TAG = "ESPEAR";
 #define RECORD_TIME_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
+// Drop the link every N seconds for OUTAGE_MS to exercise spooling, 0 disables
+#define OUTAGE_EVERY_SECONDS (0)
+#define OUTAGE_MS (3000)
+// Capture starts before the sdcard holding the spool is mounted, the i2s ringbuffer holds this much meanwhile
+#define BOOT_BUFFER_MS (1000)
+// 1: send an Ogg Opus stream a receiver can decode as it arrives, short pages keep the latency down
+#define OGG_MUX (1)
+#define OGG_PAGE_MS (100)
+// 1: stream RECORD_TIME_SECONDS, deep sleep DUTY_SLEEP_SECONDS, then wake and stream again. Each wake
+// is a new spool session, so the receiver writes one complete Ogg Opus file per wake; cat them in
+// order for one chained stream
+#define DUTY_CYCLE_MODE (0)
+#define DUTY_SLEEP_SECONDS (60)
 
+#if DUTY_CYCLE_MODE && !OGG_MUX
+#error "DUTY_CYCLE_MODE sends one Ogg stream per wake, it needs OGG_MUX"
+#endif
+
+// Bitrate controller. BITRATE_TARGET is the quality the stream needs, more only costs airtime:
+// a healthy link stays there, congestion cuts below what the receiver acknowledges, and a calm
+// stretch climbs back to the target but never past it
+#define BITRATE_MIN (12000)
+#define BITRATE_TARGET (24000)
+#define BITRATE_STEP (4000)
+#define ACK_HEADROOM_PCT (85)
+// Complexity follows the encoder's own load, not the link: it steps down while encoding takes
+// more than ENCODER_BUSY_PCT of the time and back up to COMPLEXITY below ENCODER_IDLE_PCT
+#define COMPLEXITY (5)
+#define COMPLEXITY_MIN (2)
+#define ENCODER_BUSY_PCT (40)
+#define ENCODER_IDLE_PCT (20)
+#define CONTROL_PERIOD_MS (500)
+// Congestion is read from the ringbuffer feeding the spool and from the audio the receiver
+// has not acknowledged yet. To check it, run tools/spool_receiver.py --throttle-kbps 16 and
+// expect the bitrate to settle below that with the backlog back under CONGESTED_BACKLOG_MS
+#define CONGESTED_FILL_PCT (50)
+#define CONGESTED_LATENCY_MS (40)
+#define CONGESTED_BACKLOG_MS (400)
+#define CALM_FILL_PCT (10)
+#define CALM_LATENCY_MS (5)
+#define CALM_BACKLOG_MS (150)
+#define CALM_PERIODS_TO_RAISE (6)
+
+typedef struct {
+    int bitrate;
+    int complexity;
+    int calm_periods;
+    int changes;
+    int backlog_ms;
+    int64_t last_acked;
+    int64_t last_encode_us;
+    int ack_bps;                /*!< Smoothed rate the receiver acknowledges */
+} rate_ctrl_t;
+
+static void rate_ctrl_update(rate_ctrl_t *ctrl, audio_element_handle_t enc, audio_element_handle_t sink)
+{
+    spool_stream_stats_t spool_stats;
+    spool_stream_get_stats(sink, &spool_stats);
+    // the spool's own input, fed by the ogg mux or straight by the encoder
+    ringbuf_handle_t rb = audio_element_get_input_ringbuf(sink);
+    int fill_pct = rb ? rb_bytes_filled(rb) * 100 / rb_get_size(rb) : 0;
+    int latency_ms = spool_stats.send_latency_us / 1000;
+    int backlog = spool_stats.window + spool_stats.depth;
+    ctrl->backlog_ms = (int64_t)backlog * 8000 / ctrl->bitrate;
+    int ack_bps = (spool_stats.bytes_acked - ctrl->last_acked) * 8000 / CONTROL_PERIOD_MS;
+    ctrl->last_acked = spool_stats.bytes_acked;
+    ctrl->ack_bps = ctrl->ack_bps ? (ctrl->ack_bps * 3 + ack_bps) / 4 : ack_bps;
+    opus_dyn_encoder_stats_t enc_stats;
+    opus_dyn_encoder_get_stats(enc, &enc_stats);
+    int encode_pct = (enc_stats.encode_us - ctrl->last_encode_us) * 100 / (CONTROL_PERIOD_MS * 1000);
+    ctrl->last_encode_us = enc_stats.encode_us;
+
+    int bitrate = ctrl->bitrate;
+    if (fill_pct >= CONGESTED_FILL_PCT || latency_ms >= CONGESTED_LATENCY_MS
+        || ctrl->backlog_ms >= CONGESTED_BACKLOG_MS || spool_stats.depth > 0) {
+        ctrl->calm_periods = 0;
+        bitrate = bitrate * 3 / 4;
+        // while the link is up the receiver shows what it can take, go below that in one step
+        int fits = ctrl->ack_bps * ACK_HEADROOM_PCT / 100;
+        if (spool_stats.connected && fits < bitrate) {
+            bitrate = fits;
+        }
+    } else if (fill_pct <= CALM_FILL_PCT && latency_ms <= CALM_LATENCY_MS && ctrl->backlog_ms <= CALM_BACKLOG_MS) {
+        if (++ctrl->calm_periods >= CALM_PERIODS_TO_RAISE) {
+            ctrl->calm_periods = 0;
+            bitrate += BITRATE_STEP;
+        }
+    } else {
+        ctrl->calm_periods = 0;
+    }
+    // above the target there is quality to spare, give it back as airtime
+    if (bitrate < BITRATE_MIN) {
+        bitrate = BITRATE_MIN;
+    } else if (bitrate > BITRATE_TARGET) {
+        bitrate = BITRATE_TARGET;
+    }
+
+    int complexity = ctrl->complexity;
+    if (encode_pct >= ENCODER_BUSY_PCT && complexity > COMPLEXITY_MIN) {
+        complexity--;
+    } else if (encode_pct <= ENCODER_IDLE_PCT && complexity < COMPLEXITY) {
+        complexity++;
+    }
+    if (bitrate == ctrl->bitrate && complexity == ctrl->complexity) {
+        return;
+    }
+    ctrl->changes++;
+    if (bitrate != ctrl->bitrate) {
+        ctrl->bitrate = bitrate;
+        opus_dyn_encoder_set_bitrate(enc, bitrate);
+    }
+    if (complexity != ctrl->complexity) {
+        ctrl->complexity = complexity;
+        opus_dyn_encoder_set_complexity(enc, complexity);
+    }
+    ESP_LOGI(TAG, "[ * ] rb %d%%, latency %d ms, unacknowledged %d ms, spool %d, receiver %d bps, encoder %d%% -> bitrate %d, complexity %d",
+             fill_pct, latency_ms, ctrl->backlog_ms, spool_stats.depth, ctrl->ack_bps, encode_pct, ctrl->bitrate,
+             ctrl->complexity);
+}
+
+
+#if !TEST_SIGNAL_SOURCE
+static esp_err_t start_codec(void *arg)
+{
+#if DUTY_CYCLE_MODE
+    // straight to line in, board init followed by a re-init configures the codec twice on every wake
+    audio_hal_codec_config_t duty_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    duty_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    audio_hal_handle_t hal = audio_hal_init(&duty_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+    esp_err_t ret = audio_hal_ctrl_codec(hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#else
+    audio_board_handle_t board_handle = audio_board_init();
+    
+    // change input to aux in
+    audio_hal_deinit(board_handle->audio_hal);
+    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+
+    esp_err_t ret = audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#endif
+    if (ret == ESP_OK) {
+        fast_boot_mark(FAST_BOOT_CODEC_READY);
+    }
+    return ret;
+}
+#endif
 
 void app_main(void)
 {
+    fast_boot_mark(FAST_BOOT_APP_MAIN);
+#if DUTY_CYCLE_MODE
+    duty_cycle_state_t *duty = duty_cycle_begin();
+#endif
     esp_log_level_set("*", ESP_LOG_WARN);
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
@@ -41,61 +201,104 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_netif_init());
 
     audio_pipeline_handle_t pipeline;
-    audio_element_handle_t i2s_stream_reader, opus_encoder, tcp_stream_writer;
+    audio_element_handle_t i2s_stream_reader, opus_encoder, spool_stream_writer, ogg_mux = NULL;
     
-    ESP_LOGI(TAG, "[ 2 ] Connect to WIFI");
+    ESP_LOGI(TAG, "[ 1 ] Start WIFI, the spool stream connects once the link is up");
     esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
     esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
     periph_wifi_cfg_t wifi_cfg = {
         .wifi_config.sta.ssid = CONFIG_WIFI_SSID,
         .wifi_config.sta.password = CONFIG_WIFI_PASSWORD,
     };
+#if DUTY_CYCLE_MODE
+    // skip the scan when waking, the access point of the last cycle is tried directly
+    duty_cycle_apply_wifi(&wifi_cfg.wifi_config);
+#endif
     esp_periph_handle_t wifi_handle = periph_wifi_init(&wifi_cfg);
 
     esp_periph_start(set, wifi_handle);
-    periph_wifi_wait_for_connected(wifi_handle, portMAX_DELAY);
+    fast_boot_watch_wifi(wifi_handle);
 
-    ESP_LOGI(TAG, "[ 2 ] Start codec chip");
-    audio_board_handle_t board_handle = audio_board_init();
-    
-    // change input to aux in
-    audio_hal_deinit(board_handle->audio_hal);
-    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
-    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
-    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+    // from here on only the mount step adds to the peripheral set
+    ESP_LOGI(TAG, "[1.1] Mount sdcard for the spool in the background");
+    fast_boot_step_handle_t sd_step = fast_boot_step_start("boot_sd", fast_boot_sdcard_step, set);
 
-    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#if !TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[ 2 ] Start codec chip in the background");
+    fast_boot_step_handle_t codec_step = fast_boot_step_start("boot_codec", start_codec, NULL);
+#endif
 
     ESP_LOGI(TAG, "[2.0] Create audio pipeline for listening");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
     mem_assert(pipeline);
 
-    tcp_stream_cfg_t tcp_cfg = TCP_STREAM_CFG_DEFAULT();
-    tcp_cfg.type = AUDIO_STREAM_WRITER;
-    tcp_cfg.host="192.168.137.1";
-    tcp_cfg.port=8000;
-    tcp_stream_writer = tcp_stream_init(&tcp_cfg);
+    spool_stream_cfg_t spool_cfg = SPOOL_STREAM_CFG_DEFAULT();
+    spool_cfg.host="192.168.137.1";
+    spool_cfg.port=8000;
+    spool_stream_writer = spool_stream_init(&spool_cfg);
 
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.2] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = 16000;
+    tone_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
     ESP_LOGI(TAG, "[2.2] Create i2s stream to read audio data from codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
     i2s_cfg.std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
     i2s_cfg.type = AUDIO_STREAM_READER;
+    i2s_cfg.std_cfg.clk_cfg.sample_rate_hz=16000;
+    i2s_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
     i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
 
     ESP_LOGI(TAG, "[2.3] Create opus encoder");
-    opus_encoder_cfg_t opus_cfg = DEFAULT_OPUS_ENCODER_CONFIG();
-    opus_encoder = encoder_opus_init(&opus_cfg);
+    rate_ctrl_t rate_ctrl = {
+        .bitrate = BITRATE_TARGET,
+        .complexity = COMPLEXITY,
+    };
+#if DUTY_CYCLE_MODE
+    if (duty_cycle_is_warm() && duty->bitrate) {
+        rate_ctrl.bitrate = duty->bitrate;
+    }
+#endif
+    opus_dyn_encoder_cfg_t opus_cfg = OPUS_DYN_ENCODER_CFG_DEFAULT();
+    opus_cfg.bitrate = rate_ctrl.bitrate;
+    opus_cfg.complexity = rate_ctrl.complexity;
+    opus_cfg.packet_header = OGG_MUX;
+    opus_encoder = opus_dyn_encoder_init(&opus_cfg);
+#if OGG_MUX
+    ogg_opus_mux_cfg_t ogg_cfg = OGG_OPUS_MUX_CFG_DEFAULT();
+    ogg_cfg.input_sample_rate = opus_cfg.sample_rate;
+    ogg_cfg.channels = opus_cfg.channel;
+    ogg_cfg.page_ms = OGG_PAGE_MS;
+    ogg_cfg.encoder = opus_encoder;
+#if DUTY_CYCLE_MODE
+    // a wake cannot continue the last one's stream, it arrives on a new connection and in a new
+    // receiver file without the headers. Every wake starts its own link of a chained stream instead,
+    // which needs a serial of its own
+    ogg_cfg.serial = duty->ogg_serial + duty->cycle;
+#endif
+    ogg_mux = ogg_opus_mux_init(&ogg_cfg);
+#endif
 
     ESP_LOGI(TAG, "[2.4] Register all elements to audio pipeline");
     audio_pipeline_register(pipeline, i2s_stream_reader, "i2s");
         audio_pipeline_register(pipeline, opus_encoder, "enc");
-    audio_pipeline_register(pipeline, tcp_stream_writer, "tcp");
+    audio_pipeline_register(pipeline, spool_stream_writer, "spool");
 
     ESP_LOGI(TAG, "[2.5] Link it together");
-    const char *link_tag_main[3] = {"i2s", "enc", "tcp"};
+#if OGG_MUX
+    audio_pipeline_register(pipeline, ogg_mux, "ogg");
+    const char *link_tag_main[4] = {"i2s", "enc", "ogg", "spool"};
+    audio_pipeline_link(pipeline, &link_tag_main[0], 4);
+#else
+    const char *link_tag_main[3] = {"i2s", "enc", "spool"};
     audio_pipeline_link(pipeline, &link_tag_main[0], 3);
+#endif
 
     ESP_LOGI(TAG, "[ 3 ] Set up  event listener");
     audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
@@ -107,28 +310,58 @@ void app_main(void)
     ESP_LOGI(TAG, "[3.2] Listening event from peripherals");
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(set), evt);
 
-    ESP_LOGI(TAG, "[ 4 ] Start audio_pipeline");
+    ESP_LOGI(TAG, "[ 4 ] Start capture, the spool follows once the sdcard is mounted");
+    fast_boot_mark(FAST_BOOT_PIPELINE_READY);
+#if !TEST_SIGNAL_SOURCE
+    if (fast_boot_step_wait(codec_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] Codec did not start, stop");
+        fast_boot_step_wait(sd_step);
+        goto _pipeline_exit;
+    }
+#endif
+    fast_boot_watch(i2s_stream_reader, FAST_BOOT_FIRST_SAMPLE);
+    energy_model_start();
+    audio_element_run(i2s_stream_reader);
+    audio_element_resume(i2s_stream_reader, 0, 2000 / portTICK_PERIOD_MS);
+    if (fast_boot_step_wait(sd_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] No sdcard for the spool, stop capture");
+        audio_element_stop(i2s_stream_reader);
+        audio_element_wait_for_stop(i2s_stream_reader);
+        goto _pipeline_exit;
+    }
+    // already running elements are left as they are
     audio_pipeline_run(pipeline);
 
     ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_TIME_SECONDS);
     int second_recorded = 0;
+    int64_t next_control_us = esp_timer_get_time();
     while (1) {
 
         audio_event_iface_msg_t msg;
         if (audio_event_iface_listen(evt, &msg, 1) != ESP_OK) {
+            if (esp_timer_get_time() >= next_control_us) {
+                next_control_us += CONTROL_PERIOD_MS * 1000;
+                rate_ctrl_update(&rate_ctrl, opus_encoder, spool_stream_writer);
+            }
             audio_element_info_t info;
             audio_element_getinfo(i2s_stream_reader, &info);
             int new_dur = info.byte_pos / (info.channels*(info.bits/8)*info.sample_rates);
             if(new_dur > second_recorded){
                 second_recorded = new_dur;
-                ESP_LOGI(TAG, "[ * ] Recording ... %d", second_recorded);
+                spool_stream_stats_t spool_stats;
+                spool_stream_get_stats(spool_stream_writer, &spool_stats);
+                ESP_LOGI(TAG, "[ * ] Recording ... %d, link %s, spool depth %d", second_recorded,
+                         spool_stats.connected ? "up" : "down", spool_stats.depth);
+                if (OUTAGE_EVERY_SECONDS && second_recorded % OUTAGE_EVERY_SECONDS == 0) {
+                    spool_stream_inject_outage(spool_stream_writer, OUTAGE_MS);
+                }
                 if (second_recorded >= RECORD_TIME_SECONDS) {
                     audio_element_set_ringbuf_done(i2s_stream_reader);
                 }
             }
             continue;
         }
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) tcp_stream_writer
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) spool_stream_writer
             && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
             && (((int)msg.data == AEL_STATUS_STATE_STOPPED) || ((int)msg.data == AEL_STATUS_STATE_FINISHED)
                 || ((int)msg.data == AEL_STATUS_ERROR_OPEN))) {
@@ -136,6 +369,34 @@ void app_main(void)
             break;
         }
     }
+    spool_stream_stats_t spool_stats;
+    spool_stream_get_stats(spool_stream_writer, &spool_stats);
+    ESP_LOGI(TAG, "[ * ] Spool: %lld bytes in, %lld acknowledged, %lld resent, %lld dropped, high water %d, %d outages, max catch up %d ms",
+             spool_stats.bytes_in, spool_stats.bytes_acked, spool_stats.bytes_resent, spool_stats.bytes_dropped,
+             spool_stats.depth_high_water, spool_stats.outages, spool_stats.max_catch_up_ms);
+    opus_dyn_encoder_stats_t enc_stats;
+    opus_dyn_encoder_get_stats(opus_encoder, &enc_stats);
+    ESP_LOGI(TAG, "[ * ] Encoder: %lld frames, %lld bytes, %lld us encoding, %d rate changes, final %d bps complexity %d",
+             enc_stats.frames, enc_stats.bytes_out, enc_stats.encode_us, rate_ctrl.changes,
+             enc_stats.bitrate, enc_stats.complexity);
+    // with a throttled receiver the stream has to end up inside the link, not just be cut once
+    bool kept_up = rate_ctrl.backlog_ms < CONGESTED_BACKLOG_MS;
+    ESP_LOGI(TAG, "[ * ] Rate control: receiver took %d bps, stream at %d bps, %d ms unacknowledged, %s",
+             rate_ctrl.ack_bps, enc_stats.bitrate, rate_ctrl.backlog_ms,
+             kept_up ? "kept up" : (enc_stats.bitrate == BITRATE_MIN ? "link below BITRATE_MIN" : "fell behind"));
+
+    // spooled data is written to the sdcard once and read back once
+    energy_model_add_sd(spool_stats.bytes_spooled * 2, 0);
+    energy_model_add_wifi(spool_stats.bytes_sent);
+    energy_model_report("opus_wifi", second_recorded);
+#if DUTY_CYCLE_MODE
+    duty->bitrate = enc_stats.bitrate;
+    duty_cycle_save_wifi();
+#endif
+    fast_boot_mark_at(FAST_BOOT_FIRST_SEND, spool_stats.first_send_us);
+    fast_boot_report("opus_wifi");
+
+_pipeline_exit:
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
     audio_pipeline_stop(pipeline);
     audio_pipeline_wait_for_stop(pipeline);
@@ -143,7 +404,10 @@ void app_main(void)
 
     audio_pipeline_unregister(pipeline, i2s_stream_reader);
     audio_pipeline_unregister(pipeline, opus_encoder);
-    audio_pipeline_unregister(pipeline, tcp_stream_writer);
+    audio_pipeline_unregister(pipeline, spool_stream_writer);
+    if (ogg_mux) {
+        audio_pipeline_unregister(pipeline, ogg_mux);
+    }
     
     /* Terminal the pipeline before removing the listener */
     audio_pipeline_remove_listener(pipeline);
@@ -159,7 +423,16 @@ void app_main(void)
     audio_pipeline_deinit(pipeline);
     audio_element_deinit(i2s_stream_reader);
     audio_element_deinit(opus_encoder);
-    audio_element_deinit(tcp_stream_writer);
+    audio_element_deinit(spool_stream_writer);
+    if (ogg_mux) {
+        audio_element_deinit(ogg_mux);
+    }
 
     esp_periph_set_destroy(set);
+
+#if DUTY_CYCLE_MODE
+    duty_cycle_cfg_t duty_cfg = DUTY_CYCLE_CFG_DEFAULT();
+    duty_cfg.sleep_seconds = DUTY_SLEEP_SECONDS;
+    duty_cycle_sleep(&duty_cfg, "opus_wifi");
+#endif
 }
\ No newline at end of file
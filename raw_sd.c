@@ -16,6 +16,15 @@
 #include "periph_wifi.h"
 #include "fatfs_stream.h"
 #include "i2s_stream.h"
+#include "tone_stream.h"
+#include "energy_model.h"
+#include "fast_boot.h"
+#include "zc_capture.h"
+#include "seg_stream.h"
+#include "soak_stats.h"
+#include "ringbuf.h"
+#include <fcntl.h>
+#include <unistd.h>
 #include <malloc.h>
 #include <math.h>
 
@@ -24,51 +33,181 @@
 
 static const char *TAG = "ESPEAR";
 #define RECORD_TIME_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
+// 1: skip the pipeline, I2S DMA is read into pooled buffers that are written to the card as they are
+#define ZERO_COPY_CAPTURE (0)
+// Capture starts before the sdcard is mounted, the i2s ringbuffer holds this much meanwhile
+#define BOOT_BUFFER_MS (1000)
+// 1: record SOAK_HOURS into fixed size rec_0001.i2s, rec_0002.i2s, ... and report how performance drifts
+#define SOAK_MODE (0)
+#define SOAK_HOURS (8)
+#define SOAK_SEGMENT_MB (16)
+#define SOAK_BUCKET_SECONDS (600)
 
+#if SOAK_MODE
+#define RECORD_SECONDS (SOAK_HOURS * 3600)
+#else
+#define RECORD_SECONDS RECORD_TIME_SECONDS
+#endif
 
+#if ZERO_COPY_CAPTURE && TEST_SIGNAL_SOURCE
+#error "ZERO_COPY_CAPTURE reads the I2S driver directly and has no test signal input"
+#endif
+
+#if ZERO_COPY_CAPTURE && SOAK_MODE
+#error "SOAK_MODE writes segments from the pipeline, it does not apply to ZERO_COPY_CAPTURE"
+#endif
+
+// memcpy per byte in the reader element: out of the i2s driver, then into the ringbuffer. The
+// writer element adds one more out of the ringbuffer, FatFs's own sector buffer is not counted
+#if TEST_SIGNAL_SOURCE
+#define READER_COPIES (1)
+#else
+#define READER_COPIES (2)
+#endif
+
+#if ZERO_COPY_CAPTURE
+static int sd_sink(const uint8_t *data, int len, void *ctx)
+{
+    // unbuffered write(): whole aligned sectors go from the pool buffer to the card without a stdio copy
+    return write((int)(intptr_t)ctx, data, len);
+}
+
+static void record_zero_copy(void)
+{
+    ESP_LOGI(TAG, "[2.0] Open /sdcard/rec.i2s for zero copy capture");
+    int fd = open("/sdcard/rec.i2s", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Cannot open /sdcard/rec.i2s");
+        return;
+    }
+    zc_capture_cfg_t zc_cfg = ZC_CAPTURE_CFG_DEFAULT();
+    zc_cfg.sample_rate = 16000;
+    zc_cfg.sink = sd_sink;
+    zc_cfg.sink_ctx = (void *)(intptr_t)fd;
+
+    ESP_LOGI(TAG, "[ 4 ] Start zero copy capture");
+    energy_model_start();
+    zc_capture_handle_t zc = zc_capture_start(&zc_cfg);
+    if (zc == NULL) {
+        close(fd);
+        return;
+    }
+
+    ESP_LOGI(TAG, "[ 5 ] Record for %d Seconds", RECORD_TIME_SECONDS);
+    int second_recorded = 0;
+    zc_capture_stats_t stats;
+    while (second_recorded < RECORD_TIME_SECONDS) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        zc_capture_get_stats(zc, &stats);
+        int new_dur = stats.captured_bytes / (2 * zc_cfg.sample_rate);
+        if (new_dur > second_recorded) {
+            second_recorded = new_dur;
+            ESP_LOGI(TAG, "[ * ] Recording ... %d, %d buffers in flight at most", second_recorded, stats.in_flight_max);
+        }
+    }
+    // the writer task is gone after stop, take its run time first
+    int64_t writer_us = energy_model_task_runtime_us("zc_wr");
+    zc_capture_stop(zc, &stats);
+    close(fd);
+
+    ESP_LOGI(TAG, "[ * ] Zero copy: %lld bytes captured, %lld written, %lld dropped, %d sink errors, %d ownership errors",
+             stats.captured_bytes, stats.written_bytes, stats.dropped_bytes, stats.sink_errors, stats.ownership_errors);
+    // not measured, the pipeline is not running: the reader copies and one more in the writer
+    ESP_LOGI(TAG, "[ * ] memcpy %lld bytes, the i2s -> fat pipeline would copy an estimated %lld",
+             stats.copy_bytes, stats.captured_bytes * (READER_COPIES + 1));
+    energy_model_add_sd(stats.written_bytes, writer_us);
+    energy_model_report("raw_sd_zc", second_recorded);
+}
+#endif
+
+
+
+#if !TEST_SIGNAL_SOURCE
+static esp_err_t start_codec(void *arg)
+{
+    audio_board_handle_t board_handle = audio_board_init();
+    
+    // change input to aux in
+    audio_hal_deinit(board_handle->audio_hal);
+    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+
+    esp_err_t ret = audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+    if (ret == ESP_OK) {
+        fast_boot_mark(FAST_BOOT_CODEC_READY);
+    }
+    return ret;
+}
+#endif
 
 void app_main(void)
 {
+    fast_boot_mark(FAST_BOOT_APP_MAIN);
     esp_log_level_set("*", ESP_LOG_WARN);
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
     audio_pipeline_handle_t pipeline;
     audio_element_handle_t i2s_stream_reader, fatfs_stream_writer;
     
-    ESP_LOGI(TAG, "[ 1 ] Mount sdcard");
+    ESP_LOGI(TAG, "[ 1 ] Mount sdcard in the background");
     esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
     esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
-    audio_board_sdcard_init(set, SD_MODE_1_LINE);
+    fast_boot_step_handle_t sd_step = fast_boot_step_start("boot_sd", fast_boot_sdcard_step, set);
 
 
-    ESP_LOGI(TAG, "[ 2 ] Start codec chip");
-    audio_board_handle_t board_handle = audio_board_init();
-    
-    // change input to aux in
-    audio_hal_deinit(board_handle->audio_hal);
-    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
-    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
-    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+#if !TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[ 2 ] Start codec chip in the background");
+    fast_boot_step_handle_t codec_step = fast_boot_step_start("boot_codec", start_codec, NULL);
+#endif
 
-    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#if ZERO_COPY_CAPTURE
+    esp_err_t sd_ret = fast_boot_step_wait(sd_step);
+    if (fast_boot_step_wait(codec_step) == ESP_OK && sd_ret == ESP_OK) {
+        record_zero_copy();
+    } else {
+        ESP_LOGE(TAG, "[ * ] Sdcard or codec did not come up, nothing recorded");
+    }
+    esp_periph_set_stop_all(set);
+    esp_periph_set_destroy(set);
+    return;
+#endif
 
     ESP_LOGI(TAG, "[2.0] Create audio pipeline for listening");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
     mem_assert(pipeline);
 
+#if SOAK_MODE
+    ESP_LOGI(TAG, "[2.1] Create segment stream to write %d MB files to sdcard", SOAK_SEGMENT_MB);
+    seg_stream_cfg_t seg_cfg = SEG_STREAM_CFG_DEFAULT();
+    seg_cfg.segment_size = SOAK_SEGMENT_MB * 1024 * 1024;
+    fatfs_stream_writer = seg_stream_init(&seg_cfg);
+#else
     ESP_LOGI(TAG, "[2.1] Create fatfs stream to write data to sdcard");
     fatfs_stream_cfg_t fatfs_cfg = FATFS_STREAM_CFG_DEFAULT();
     fatfs_cfg.type = AUDIO_STREAM_WRITER;
     fatfs_stream_writer = fatfs_stream_init(&fatfs_cfg);
+#endif
 
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.2] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = 16000;
+    tone_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
     ESP_LOGI(TAG, "[2.2] Create i2s stream to read audio data from codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
     i2s_cfg.std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
     i2s_cfg.type = AUDIO_STREAM_READER;
     i2s_cfg.std_cfg.clk_cfg.sample_rate_hz=16000;
+    i2s_cfg.out_rb_size = 16000 * 2 * BOOT_BUFFER_MS / 1000;
     i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
     
 
     ESP_LOGI(TAG, "[2.3] Register all elements to audio pipeline");
@@ -85,7 +224,9 @@ void app_main(void)
     ESP_LOGI(TAG, "[ * ] Save the recording info to the fatfs stream writer, sample_rates=%d, bits=%d, ch=%d",
                 music_info.sample_rates, music_info.bits, music_info.channels);
     audio_element_setinfo(fatfs_stream_writer, &music_info);
+#if !SOAK_MODE
     audio_element_set_uri(fatfs_stream_writer, "/sdcard/rec.i2s");
+#endif
 
 
     ESP_LOGI(TAG, "[ 3 ] Set up  event listener");
@@ -98,21 +239,57 @@ void app_main(void)
     ESP_LOGI(TAG, "[3.2] Listening event from peripherals");
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(set), evt);
 
-    ESP_LOGI(TAG, "[ 4 ] Start audio_pipeline");
+    ESP_LOGI(TAG, "[ 4 ] Start capture, the writer follows once the sdcard is mounted");
+    fast_boot_mark(FAST_BOOT_PIPELINE_READY);
+#if !TEST_SIGNAL_SOURCE
+    if (fast_boot_step_wait(codec_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] Codec did not start, stop");
+        fast_boot_step_wait(sd_step);
+        goto _pipeline_exit;
+    }
+#endif
+    fast_boot_watch(i2s_stream_reader, FAST_BOOT_FIRST_SAMPLE);
+    fast_boot_watch(fatfs_stream_writer, FAST_BOOT_FIRST_WRITE);
+    energy_model_start();
+#if SOAK_MODE
+    soak_stats_cfg_t soak_cfg = SOAK_STATS_CFG_DEFAULT();
+    soak_cfg.bucket_seconds = SOAK_BUCKET_SECONDS;
+    soak_stats_start(&soak_cfg);
+    ringbuf_handle_t capture_rb = audio_element_get_output_ringbuf(i2s_stream_reader);
+#endif
+    audio_element_run(i2s_stream_reader);
+    audio_element_resume(i2s_stream_reader, 0, 2000 / portTICK_PERIOD_MS);
+    if (fast_boot_step_wait(sd_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] No sdcard, stop capture");
+        audio_element_stop(i2s_stream_reader);
+        audio_element_wait_for_stop(i2s_stream_reader);
+        goto _pipeline_exit;
+    }
+    // already running elements are left as they are
     audio_pipeline_run(pipeline);
 
-    ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_TIME_SECONDS);
+    ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_SECONDS);
     int second_recorded = 0;
     while (1) {
         audio_event_iface_msg_t msg;
         if (audio_event_iface_listen(evt, &msg, 1) != ESP_OK) {
+#if SOAK_MODE
+            soak_stats_record(SOAK_RB_FILL, rb_bytes_filled(capture_rb));
+#endif
             audio_element_info_t info;
             audio_element_getinfo(i2s_stream_reader, &info);
             int new_dur = info.byte_pos / (info.channels*(info.bits/8)*info.sample_rates);
             if(new_dur > second_recorded){
                 second_recorded = new_dur;
+#if SOAK_MODE
+                soak_stats_tick();
+                if (second_recorded % 60 == 0) {
+                    ESP_LOGI(TAG, "[ * ] Recording ... %d min", second_recorded / 60);
+                }
+#else
                 ESP_LOGI(TAG, "[ * ] Recording ... %d", second_recorded);
-                if (second_recorded >= RECORD_TIME_SECONDS) {
+#endif
+                if (second_recorded >= RECORD_SECONDS) {
                     audio_element_set_ringbuf_done(i2s_stream_reader);
                 }
             }
@@ -127,6 +304,21 @@ void app_main(void)
             break;
         }
     }
+    audio_element_info_t fatfs_info, reader_info;
+    audio_element_getinfo(fatfs_stream_writer, &fatfs_info);
+    audio_element_getinfo(i2s_stream_reader, &reader_info);
+    // counted per element from the bytes each one moved
+    int64_t copied = reader_info.byte_pos * READER_COPIES + fatfs_info.byte_pos;
+    ESP_LOGI(TAG, "[ * ] %lld bytes recorded, %lld bytes memcpy on the way", fatfs_info.byte_pos, copied);
+    // element tasks are named after the tag, the segment writer in SOAK_MODE included
+    energy_model_add_sd(fatfs_info.byte_pos, energy_model_task_runtime_us(audio_element_get_tag(fatfs_stream_writer)));
+    energy_model_report("raw_sd", second_recorded);
+    fast_boot_report("raw_sd");
+#if SOAK_MODE
+    soak_stats_report("raw_sd");
+#endif
+
+_pipeline_exit:
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
     audio_pipeline_stop(pipeline);
     audio_pipeline_wait_for_stop(pipeline);
@@ -153,4 +345,7 @@ void app_main(void)
     audio_element_deinit(fatfs_stream_writer);
 
     esp_periph_set_destroy(set);
+#if SOAK_MODE
+    soak_stats_stop();
+#endif
 }
\ No newline at end of file
@@ -15,17 +15,130 @@
 #include "board.h"
 #include "esp_peripherals.h"
 #include "periph_wifi.h"
+#include "periph_sdcard.h"
 #include "i2s_stream.h"
-#include "tcp_client_stream.h"
+#include "tone_stream.h"
+#include "energy_model.h"
+#include "fast_boot.h"
+#include "spool_stream.h"
+#include "zc_capture.h"
 #include "esp_netif.h"
+#include "lwip/sockets.h"
 
 
 static const char *TAG = "ESPEAR";
 #define RECORD_TIME_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
+// Drop the link every N seconds for OUTAGE_MS to exercise spooling, 0 disables
+#define OUTAGE_EVERY_SECONDS (0)
+#define OUTAGE_MS (3000)
+// Capture starts before the sdcard holding the spool is mounted, the i2s ringbuffer holds this much meanwhile
+#define BOOT_BUFFER_MS (500)
+// 1: skip the pipeline, I2S DMA is read into pooled buffers that are sent as they are.
+// There is no spool in this mode, a stalled link drops whole buffers once the pool is full
+#define ZERO_COPY_CAPTURE (0)
+// run tools/spool_receiver.py there, ZERO_COPY_CAPTURE sends plain TCP without the resume handshake
+#define STREAM_HOST "192.168.137.1"
+#define STREAM_PORT (8000)
 
+#if ZERO_COPY_CAPTURE && TEST_SIGNAL_SOURCE
+#error "ZERO_COPY_CAPTURE reads the I2S driver directly and has no test signal input"
+#endif
+
+#if ZERO_COPY_CAPTURE
+static int socket_sink(const uint8_t *data, int len, void *ctx)
+{
+    int sock = (int)(intptr_t)ctx;
+    int sent = 0;
+    while (sent < len) {
+        int n = send(sock, data + sent, len - sent, 0);
+        if (n < 0) {
+            return -1;
+        }
+        sent += n;
+    }
+    return sent;
+}
+
+static void record_zero_copy(esp_periph_handle_t wifi_handle)
+{
+    ESP_LOGI(TAG, "[2.0] Connect to %s:%d for zero copy capture", STREAM_HOST, STREAM_PORT);
+    periph_wifi_wait_for_connected(wifi_handle, portMAX_DELAY);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(STREAM_PORT),
+        .sin_addr.s_addr = inet_addr(STREAM_HOST),
+    };
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "Cannot connect to %s:%d", STREAM_HOST, STREAM_PORT);
+        if (sock >= 0) {
+            close(sock);
+        }
+        return;
+    }
+    zc_capture_cfg_t zc_cfg = ZC_CAPTURE_CFG_DEFAULT();
+    zc_cfg.sample_rate = 44100;
+    zc_cfg.sink = socket_sink;
+    zc_cfg.sink_ctx = (void *)(intptr_t)sock;
+
+    ESP_LOGI(TAG, "[ 4 ] Start zero copy capture");
+    energy_model_start();
+    zc_capture_handle_t zc = zc_capture_start(&zc_cfg);
+    if (zc == NULL) {
+        close(sock);
+        return;
+    }
+
+    ESP_LOGI(TAG, "[ 5 ] Record for %d Seconds", RECORD_TIME_SECONDS);
+    int second_recorded = 0;
+    zc_capture_stats_t stats;
+    while (second_recorded < RECORD_TIME_SECONDS) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+        zc_capture_get_stats(zc, &stats);
+        int new_dur = stats.captured_bytes / (2 * zc_cfg.sample_rate);
+        if (new_dur > second_recorded) {
+            second_recorded = new_dur;
+            ESP_LOGI(TAG, "[ * ] Recording ... %d, %d buffers in flight at most", second_recorded, stats.in_flight_max);
+        }
+    }
+    zc_capture_stop(zc, &stats);
+    close(sock);
+
+    ESP_LOGI(TAG, "[ * ] Zero copy: %lld bytes captured, %lld sent, %lld dropped, %d sink errors, %d ownership errors",
+             stats.captured_bytes, stats.written_bytes, stats.dropped_bytes, stats.sink_errors, stats.ownership_errors);
+    // not measured, the pipeline is not running: i2s driver -> reader buffer -> ringbuffer -> spool buffer -> send window
+    ESP_LOGI(TAG, "[ * ] memcpy %lld bytes, the i2s -> spool pipeline would copy an estimated %lld",
+             stats.copy_bytes, stats.captured_bytes * 4);
+    energy_model_add_wifi(stats.written_bytes);
+    energy_model_report("raw_wifi_zc", second_recorded);
+}
+#endif
+
+
+#if !TEST_SIGNAL_SOURCE
+static esp_err_t start_codec(void *arg)
+{
+    audio_board_handle_t board_handle = audio_board_init();
+    
+    // change input to aux in
+    audio_hal_deinit(board_handle->audio_hal);
+    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+
+    esp_err_t ret = audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+    if (ret == ESP_OK) {
+        fast_boot_mark(FAST_BOOT_CODEC_READY);
+    }
+    return ret;
+}
+#endif
 
 void app_main(void)
 {
+    fast_boot_mark(FAST_BOOT_APP_MAIN);
     esp_log_level_set("*", ESP_LOG_WARN);
     esp_log_level_set(TAG, ESP_LOG_INFO);
 
@@ -40,9 +153,9 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_netif_init());
 
     audio_pipeline_handle_t pipeline;
-    audio_element_handle_t i2s_stream_reader, tcp_stream_writer;
+    audio_element_handle_t i2s_stream_reader, spool_stream_writer;
     
-    ESP_LOGI(TAG, "[ 2 ] Connect to WIFI");
+    ESP_LOGI(TAG, "[ 1 ] Start WIFI, the spool stream connects once the link is up");
     esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
     esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
     periph_wifi_cfg_t wifi_cfg = {
@@ -52,45 +165,67 @@ void app_main(void)
     esp_periph_handle_t wifi_handle = periph_wifi_init(&wifi_cfg);
 
     esp_periph_start(set, wifi_handle);
-    periph_wifi_wait_for_connected(wifi_handle, portMAX_DELAY);
+    fast_boot_watch_wifi(wifi_handle);
 
-    ESP_LOGI(TAG, "[ 2 ] Start codec chip");
-    audio_board_handle_t board_handle = audio_board_init();
-    
-    // change input to aux in
-    audio_hal_deinit(board_handle->audio_hal);
-    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
-    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
-    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+#if ZERO_COPY_CAPTURE
+    // no spool in this mode, the sdcard is never mounted
+    fast_boot_step_handle_t sd_step = NULL;
+#else
+    // from here on only the mount step adds to the peripheral set
+    ESP_LOGI(TAG, "[1.1] Mount sdcard for the spool in the background");
+    fast_boot_step_handle_t sd_step = fast_boot_step_start("boot_sd", fast_boot_sdcard_step, set);
+#endif
+
+#if !TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[ 2 ] Start codec chip in the background");
+    fast_boot_step_handle_t codec_step = fast_boot_step_start("boot_codec", start_codec, NULL);
+#endif
 
-    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#if ZERO_COPY_CAPTURE
+    if (fast_boot_step_wait(codec_step) == ESP_OK) {
+        record_zero_copy(wifi_handle);
+    } else {
+        ESP_LOGE(TAG, "[ * ] Codec did not start, nothing recorded");
+    }
+    esp_periph_set_stop_all(set);
+    esp_periph_set_destroy(set);
+    return;
+#endif
 
     ESP_LOGI(TAG, "[2.0] Create audio pipeline for listening");
     audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
     pipeline = audio_pipeline_init(&pipeline_cfg);
     mem_assert(pipeline);
 
-    tcp_stream_cfg_t tcp_cfg = TCP_STREAM_CFG_DEFAULT();
-    tcp_cfg.type = AUDIO_STREAM_WRITER;
-    tcp_cfg.host="192.168.137.1";
-    tcp_cfg.port=8000;
-    tcp_stream_writer = tcp_stream_init(&tcp_cfg);
+    spool_stream_cfg_t spool_cfg = SPOOL_STREAM_CFG_DEFAULT();
+    spool_cfg.host = STREAM_HOST;
+    spool_cfg.port = STREAM_PORT;
+    spool_stream_writer = spool_stream_init(&spool_cfg);
 
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.2] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = 44100;
+    tone_cfg.out_rb_size = 44100 * 2 * BOOT_BUFFER_MS / 1000;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
     ESP_LOGI(TAG, "[2.2] Create i2s stream to read audio data from codec chip");
     i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
     i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
     i2s_cfg.std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
     i2s_cfg.type = AUDIO_STREAM_READER;
+    i2s_cfg.out_rb_size = 44100 * 2 * BOOT_BUFFER_MS / 1000;
     i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
 
     
 
     ESP_LOGI(TAG, "[2.3] Register all elements to audio pipeline");
     audio_pipeline_register(pipeline, i2s_stream_reader, "i2s");
-    audio_pipeline_register(pipeline, tcp_stream_writer, "tcp");
+    audio_pipeline_register(pipeline, spool_stream_writer, "spool");
 
     ESP_LOGI(TAG, "[2.4] Link it together");
-    const char *link_tag_main[2] = {"i2s", "tcp"};
+    const char *link_tag_main[2] = {"i2s", "spool"};
     audio_pipeline_link(pipeline, &link_tag_main[0], 2);
 
     ESP_LOGI(TAG, "[ 3 ] Set up  event listener");
@@ -103,7 +238,26 @@ void app_main(void)
     ESP_LOGI(TAG, "[3.2] Listening event from peripherals");
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(set), evt);
 
-    ESP_LOGI(TAG, "[ 4 ] Start audio_pipeline");
+    ESP_LOGI(TAG, "[ 4 ] Start capture, the spool follows once the sdcard is mounted");
+    fast_boot_mark(FAST_BOOT_PIPELINE_READY);
+#if !TEST_SIGNAL_SOURCE
+    if (fast_boot_step_wait(codec_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] Codec did not start, stop");
+        fast_boot_step_wait(sd_step);
+        goto _pipeline_exit;
+    }
+#endif
+    fast_boot_watch(i2s_stream_reader, FAST_BOOT_FIRST_SAMPLE);
+    energy_model_start();
+    audio_element_run(i2s_stream_reader);
+    audio_element_resume(i2s_stream_reader, 0, 2000 / portTICK_PERIOD_MS);
+    if (fast_boot_step_wait(sd_step) != ESP_OK) {
+        ESP_LOGE(TAG, "[ * ] No sdcard for the spool, stop capture");
+        audio_element_stop(i2s_stream_reader);
+        audio_element_wait_for_stop(i2s_stream_reader);
+        goto _pipeline_exit;
+    }
+    // already running elements are left as they are
     audio_pipeline_run(pipeline);
 
     ESP_LOGI(TAG, "[ 5 ] Listen for all pipeline events, record for %d Seconds", RECORD_TIME_SECONDS);
@@ -117,14 +271,20 @@ void app_main(void)
             int new_dur = info.byte_pos / (info.channels*(info.bits/8)*info.sample_rates);
             if(new_dur > second_recorded){
                 second_recorded = new_dur;
-                ESP_LOGI(TAG, "[ * ] Recording ... %d", second_recorded);
+                spool_stream_stats_t spool_stats;
+                spool_stream_get_stats(spool_stream_writer, &spool_stats);
+                ESP_LOGI(TAG, "[ * ] Recording ... %d, link %s, spool depth %d", second_recorded,
+                         spool_stats.connected ? "up" : "down", spool_stats.depth);
+                if (OUTAGE_EVERY_SECONDS && second_recorded % OUTAGE_EVERY_SECONDS == 0) {
+                    spool_stream_inject_outage(spool_stream_writer, OUTAGE_MS);
+                }
                 if (second_recorded >= RECORD_TIME_SECONDS) {
                     audio_element_set_ringbuf_done(i2s_stream_reader);
                 }
             }
             continue;
         }
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) tcp_stream_writer
+        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT && msg.source == (void *) spool_stream_writer
             && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
             && (((int)msg.data == AEL_STATUS_STATE_STOPPED) || ((int)msg.data == AEL_STATUS_STATE_FINISHED)
                 || ((int)msg.data == AEL_STATUS_ERROR_OPEN))) {
@@ -132,13 +292,27 @@ void app_main(void)
             break;
         }
     }
+    spool_stream_stats_t spool_stats;
+    spool_stream_get_stats(spool_stream_writer, &spool_stats);
+    ESP_LOGI(TAG, "[ * ] Spool: %lld bytes in, %lld acknowledged, %lld resent, %lld dropped, high water %d, %d outages, max catch up %d ms",
+             spool_stats.bytes_in, spool_stats.bytes_acked, spool_stats.bytes_resent, spool_stats.bytes_dropped,
+             spool_stats.depth_high_water, spool_stats.outages, spool_stats.max_catch_up_ms);
+
+    // spooled data is written to the sdcard once and read back once
+    energy_model_add_sd(spool_stats.bytes_spooled * 2, 0);
+    energy_model_add_wifi(spool_stats.bytes_sent);
+    energy_model_report("raw_wifi", second_recorded);
+    fast_boot_mark_at(FAST_BOOT_FIRST_SEND, spool_stats.first_send_us);
+    fast_boot_report("raw_wifi");
+
+_pipeline_exit:
     ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
     audio_pipeline_stop(pipeline);
     audio_pipeline_wait_for_stop(pipeline);
     audio_pipeline_terminate(pipeline);
 
     audio_pipeline_unregister(pipeline, i2s_stream_reader);
-    audio_pipeline_unregister(pipeline, tcp_stream_writer);
+    audio_pipeline_unregister(pipeline, spool_stream_writer);
     
     /* Terminal the pipeline before removing the listener */
     audio_pipeline_remove_listener(pipeline);
@@ -153,7 +327,7 @@ void app_main(void)
     /* Release all resources */
     audio_pipeline_deinit(pipeline);
     audio_element_deinit(i2s_stream_reader);
-    audio_element_deinit(tcp_stream_writer);
+    audio_element_deinit(spool_stream_writer);
 
     esp_periph_set_destroy(set);
 }
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "soak_stats.h"
+#include "seg_stream.h"
+
+static const char *TAG = "SEG_STREAM";
+
+#define SEG_STREAM_PATH_MAX (64)
+
+typedef struct seg_stream {
+    seg_stream_cfg_t    cfg;
+    int                 fd;
+    int                 written;
+    int                 next_fd;        /*!< Prepared by the helper, -1 until prep_done */
+    int                 retire_fd;      /*!< Full segment for the helper to close */
+    bool                running;
+    SemaphoreHandle_t   prep_req;
+    SemaphoreHandle_t   prep_done;
+    SemaphoreHandle_t   prep_exit;
+    seg_stream_stats_t  stats;
+} seg_stream_t;
+
+static void _segment_path(seg_stream_t *s, int index, char *path)
+{
+    snprintf(path, SEG_STREAM_PATH_MAX, s->cfg.path_fmt, index);
+}
+
+static int _segment_open(seg_stream_t *s, int index)
+{
+    char path[SEG_STREAM_PATH_MAX];
+    _segment_path(s, index, path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return -1;
+    }
+    if (s->cfg.preallocate) {
+        // FAT allocates the whole cluster chain when seeking past the end of a file open for
+        // writing, later writes then only fill sectors and leave the FAT alone
+        if (lseek(fd, s->cfg.segment_size - 1, SEEK_SET) < 0 || write(fd, "", 1) != 1) {
+            s->stats.prealloc_failed++;
+            ESP_LOGW(TAG, "Cannot preallocate %s, writing it unsized", path);
+        }
+        lseek(fd, 0, SEEK_SET);
+    }
+    return fd;
+}
+
+static void _seg_prep(void *arg)
+{
+    seg_stream_t *s = (seg_stream_t *)arg;
+    while (1) {
+        xSemaphoreTake(s->prep_req, portMAX_DELAY);
+        if (!s->running) {
+            break;
+        }
+        int64_t start = esp_timer_get_time();
+        if (s->retire_fd >= 0) {
+            close(s->retire_fd);
+            s->retire_fd = -1;
+        }
+        s->next_fd = _segment_open(s, s->stats.segment + 1);
+        int prep_us = esp_timer_get_time() - start;
+        if (prep_us > s->stats.prep_us_max) {
+            s->stats.prep_us_max = prep_us;
+        }
+        xSemaphoreGive(s->prep_done);
+    }
+    xSemaphoreGive(s->prep_exit);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t _seg_rotate(seg_stream_t *s)
+{
+    if (xSemaphoreTake(s->prep_done, 0) != pdTRUE) {
+        int64_t start = esp_timer_get_time();
+        xSemaphoreTake(s->prep_done, portMAX_DELAY);
+        int wait_us = esp_timer_get_time() - start;
+        s->stats.rotate_waits++;
+        if (wait_us > s->stats.rotate_wait_us_max) {
+            s->stats.rotate_wait_us_max = wait_us;
+        }
+    }
+    if (s->next_fd < 0) {
+        return ESP_FAIL;
+    }
+    s->retire_fd = s->fd;
+    s->fd = s->next_fd;
+    s->next_fd = -1;
+    s->written = 0;
+    s->stats.segment++;
+    xSemaphoreGive(s->prep_req);
+    return ESP_OK;
+}
+
+static esp_err_t _seg_open(audio_element_handle_t self)
+{
+    seg_stream_t *s = (seg_stream_t *)audio_element_getdata(self);
+    if (s->fd >= 0) {
+        return ESP_OK;
+    }
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->stats.segment = 1;
+    s->written = 0;
+    s->next_fd = -1;
+    s->retire_fd = -1;
+    xSemaphoreTake(s->prep_done, 0);
+    s->fd = _segment_open(s, s->stats.segment);
+    if (s->fd < 0) {
+        return ESP_FAIL;
+    }
+    s->running = true;
+    if (xTaskCreatePinnedToCore(_seg_prep, "seg_prep", 3 * 1024, s, s->cfg.task_prio - 1,
+                                NULL, s->cfg.task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create helper task");
+        s->running = false;
+        close(s->fd);
+        s->fd = -1;
+        return ESP_FAIL;
+    }
+    xSemaphoreGive(s->prep_req);
+    return ESP_OK;
+}
+
+static int _seg_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    seg_stream_t *s = (seg_stream_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    int off = 0;
+    while (off < r_size) {
+        if (s->written >= s->cfg.segment_size && _seg_rotate(s) != ESP_OK) {
+            ESP_LOGE(TAG, "No segment after %d", s->stats.segment);
+            return AEL_IO_FAIL;
+        }
+        int n = r_size - off;
+        if (n > s->cfg.segment_size - s->written) {
+            n = s->cfg.segment_size - s->written;
+        }
+        int64_t start = esp_timer_get_time();
+        int w = write(s->fd, in_buffer + off, n);
+        int write_us = esp_timer_get_time() - start;
+        soak_stats_record(SOAK_WRITE_US, write_us);
+        if (write_us > s->stats.write_us_max) {
+            s->stats.write_us_max = write_us;
+        }
+        if (w != n) {
+            s->stats.write_errors++;
+            ESP_LOGE(TAG, "Write failed in segment %d at %d", s->stats.segment, s->written);
+            return AEL_IO_FAIL;
+        }
+        off += n;
+        s->written += n;
+        s->stats.bytes_written += n;
+    }
+    audio_element_update_byte_pos(self, r_size);
+    return r_size;
+}
+
+static esp_err_t _seg_close(audio_element_handle_t self)
+{
+    seg_stream_t *s = (seg_stream_t *)audio_element_getdata(self);
+    if (s->fd < 0) {
+        return ESP_OK;
+    }
+    s->running = false;
+    xSemaphoreGive(s->prep_req);
+    xSemaphoreTake(s->prep_exit, portMAX_DELAY);
+    if (s->retire_fd >= 0) {
+        close(s->retire_fd);
+        s->retire_fd = -1;
+    }
+    if (s->next_fd >= 0) {
+        // prepared but never written, leave no empty full size file behind
+        char path[SEG_STREAM_PATH_MAX];
+        _segment_path(s, s->stats.segment + 1, path);
+        close(s->next_fd);
+        s->next_fd = -1;
+        unlink(path);
+    }
+    if (s->cfg.preallocate) {
+        ftruncate(s->fd, s->written);
+    }
+    close(s->fd);
+    s->fd = -1;
+    seg_stream_stats_t *st = &s->stats;
+    ESP_LOGI(TAG, "%lld bytes in %d segments, write max %d us, prepare max %d us, %d rotations waited (max %d us), %d errors",
+             st->bytes_written, st->segment, st->write_us_max, st->prep_us_max, st->rotate_waits,
+             st->rotate_wait_us_max, st->write_errors);
+    return ESP_OK;
+}
+
+static esp_err_t _seg_destroy(audio_element_handle_t self)
+{
+    seg_stream_t *s = (seg_stream_t *)audio_element_getdata(self);
+    vSemaphoreDelete(s->prep_req);
+    vSemaphoreDelete(s->prep_done);
+    vSemaphoreDelete(s->prep_exit);
+    audio_free(s);
+    return ESP_OK;
+}
+
+esp_err_t seg_stream_get_stats(audio_element_handle_t self, seg_stream_stats_t *stats)
+{
+    seg_stream_t *s = (seg_stream_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, s, return ESP_FAIL);
+    memcpy(stats, &s->stats, sizeof(*stats));
+    return ESP_OK;
+}
+
+audio_element_handle_t seg_stream_init(seg_stream_cfg_t *config)
+{
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    AUDIO_NULL_CHECK(TAG, config->path_fmt, return NULL);
+    if (config->segment_size <= 0) {
+        ESP_LOGE(TAG, "Bad segment size %d", config->segment_size);
+        return NULL;
+    }
+    seg_stream_t *s = audio_calloc(1, sizeof(seg_stream_t));
+    AUDIO_MEM_CHECK(TAG, s, return NULL);
+    memcpy(&s->cfg, config, sizeof(seg_stream_cfg_t));
+    s->fd = -1;
+    s->next_fd = -1;
+    s->retire_fd = -1;
+    s->prep_req = xSemaphoreCreateBinary();
+    s->prep_done = xSemaphoreCreateBinary();
+    s->prep_exit = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, s->prep_req, goto _seg_init_exit);
+    AUDIO_MEM_CHECK(TAG, s->prep_done, goto _seg_init_exit);
+    AUDIO_MEM_CHECK(TAG, s->prep_exit, goto _seg_init_exit);
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _seg_open;
+    cfg.close = _seg_close;
+    cfg.process = _seg_process;
+    cfg.destroy = _seg_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.buffer_len = config->buffer_len;
+    cfg.tag = "seg";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _seg_init_exit);
+    audio_element_setdata(el, s);
+    return el;
+
+_seg_init_exit:
+    if (s->prep_req) {
+        vSemaphoreDelete(s->prep_req);
+    }
+    if (s->prep_done) {
+        vSemaphoreDelete(s->prep_done);
+    }
+    if (s->prep_exit) {
+        vSemaphoreDelete(s->prep_exit);
+    }
+    audio_free(s);
+    return NULL;
+}
\ No newline at end of file
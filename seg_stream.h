@@ -0,0 +1,88 @@
+#ifndef _SEG_STREAM_H_
+#define _SEG_STREAM_H_
+
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Segment stream configuration
+ *
+ *          A file writer for runs of hours. The input is split into fixed size files
+ *          named from path_fmt and a counter starting at 1. After a clean close they
+ *          concatenate to the whole stream; after a crash the preallocated segments keep
+ *          their full size with stale data after the last write, and so does the last one.
+ *
+ *          A helper task creates and preallocates the next segment and closes the finished
+ *          one, so the writer only swaps file descriptors at a boundary and every write
+ *          lands in clusters that are already allocated. That moves the work out of the
+ *          writer task but not out of its way: FatFs serialises all calls on a volume with
+ *          one lock, so a write that comes while the helper allocates the cluster chain
+ *          waits for it. rotate_waits and write_us_max show what that costs.
+ */
+typedef struct {
+    const char  *path_fmt;              /*!< printf format with one int, e.g. "/sdcard/rec_%04d.i2s" */
+    int         segment_size;           /*!< Bytes per segment */
+    bool        preallocate;            /*!< Size each segment up front, the last one is cut back on close */
+    int         buffer_len;             /*!< Element buffer size, keep it a multiple of 512 */
+    int         task_stack;             /*!< Element task stack */
+    int         task_core;              /*!< Element and helper task core */
+    int         task_prio;              /*!< Element task priority, the helper runs one below */
+} seg_stream_cfg_t;
+
+/**
+ * @brief   Segment stream counters, since the element was opened
+ */
+typedef struct {
+    int64_t     bytes_written;          /*!< Bytes written over all segments */
+    int         segment;                /*!< Number of the segment being written */
+    int         write_errors;
+    int         write_us_max;           /*!< Slowest single write() */
+    int         prep_us_max;            /*!< Slowest create and preallocate, writes to the volume wait meanwhile */
+    int         rotate_waits;           /*!< Boundaries reached before the next segment was ready */
+    int         rotate_wait_us_max;     /*!< Longest of those waits, 0 while every rotation was seamless */
+    int         prealloc_failed;        /*!< Segments that could not be sized up front */
+} seg_stream_stats_t;
+
+#define SEG_STREAM_TASK_STACK       (3 * 1024)
+#define SEG_STREAM_TASK_CORE        (0)
+#define SEG_STREAM_TASK_PRIO        (5)
+#define SEG_STREAM_BUF_SIZE         (4 * 1024)
+#define SEG_STREAM_SEGMENT_SIZE     (16 * 1024 * 1024)
+
+#define SEG_STREAM_CFG_DEFAULT() {                  \
+    .path_fmt = "/sdcard/rec_%04d.i2s",             \
+    .segment_size = SEG_STREAM_SEGMENT_SIZE,        \
+    .preallocate = true,                            \
+    .buffer_len = SEG_STREAM_BUF_SIZE,              \
+    .task_stack = SEG_STREAM_TASK_STACK,            \
+    .task_core = SEG_STREAM_TASK_CORE,              \
+    .task_prio = SEG_STREAM_TASK_PRIO,              \
+}
+
+/**
+ * @brief      Create a segment stream writer
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL on failure
+ */
+audio_element_handle_t seg_stream_init(seg_stream_cfg_t *config);
+
+/**
+ * @brief      Read the current counters
+ *
+ * @param      self   The segment stream handle
+ * @param      stats  Filled with the current values
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t seg_stream_get_stats(audio_element_handle_t self, seg_stream_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,299 @@
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+
+#include "soak_stats.h"
+
+static const char *TAG = "SOAK_STATS";
+
+/* log2 bins: bin 0 holds 0, bin b holds 2^(b-1) .. 2^b - 1, the last bin everything above */
+#define SOAK_HIST_BINS (24)
+
+typedef struct {
+    uint32_t    count;
+    uint32_t    min;
+    uint32_t    max;
+    uint64_t    sum;
+    uint32_t    hist[SOAK_HIST_BINS];
+} soak_hist_t;
+
+typedef struct {
+    soak_hist_t m[SOAK_METRIC_MAX];
+} soak_bucket_t;
+
+static const char *metric_names[SOAK_METRIC_MAX] = {
+    "write_us",
+    "encode_us",
+    "rb_fill",
+    "free_heap",
+    "largest_block",
+};
+
+static soak_bucket_t *buckets;
+static int bucket_num;
+static int64_t bucket_us;
+static int64_t start_us;
+static int last_logged;
+static bool running;
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int _bin(uint32_t v)
+{
+    int b = v ? 32 - __builtin_clz(v) : 0;
+    return b < SOAK_HIST_BINS ? b : SOAK_HIST_BINS - 1;
+}
+
+static void _hist_add(soak_hist_t *h, uint32_t v)
+{
+    if (h->count == 0 || v < h->min) {
+        h->min = v;
+    }
+    if (v > h->max) {
+        h->max = v;
+    }
+    h->count++;
+    h->sum += v;
+    h->hist[_bin(v)]++;
+}
+
+static void _hist_merge(soak_hist_t *dst, const soak_hist_t *src)
+{
+    if (src->count == 0) {
+        return;
+    }
+    if (dst->count == 0 || src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    for (int b = 0; b < SOAK_HIST_BINS; b++) {
+        dst->hist[b] += src->hist[b];
+    }
+}
+
+// upper edge of the bin holding the q-th fraction of samples, never above the real max
+static uint32_t _hist_quantile(const soak_hist_t *h, float q)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(q * (h->count - 1));
+    uint32_t seen = 0;
+    for (int b = 0; b < SOAK_HIST_BINS - 1; b++) {
+        seen += h->hist[b];
+        if (seen > rank) {
+            uint32_t upper = b ? (1u << b) - 1 : 0;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+static uint32_t _hist_mean(const soak_hist_t *h)
+{
+    return h->count ? (uint32_t)(h->sum / h->count) : 0;
+}
+
+// called with the lock held, halves the time resolution when the run outgrows the buckets.
+// A merged bucket whose first half was already logged is logged again as a whole
+static int _bucket_index(int64_t now)
+{
+    int idx = (now - start_us) / bucket_us;
+    while (idx >= bucket_num) {
+        for (int i = 0; i < bucket_num / 2; i++) {
+            if (i > 0) {
+                buckets[i] = buckets[2 * i];
+            }
+            for (int k = 0; k < SOAK_METRIC_MAX; k++) {
+                _hist_merge(&buckets[i].m[k], &buckets[2 * i + 1].m[k]);
+            }
+        }
+        memset(&buckets[bucket_num / 2], 0, sizeof(soak_bucket_t) * (bucket_num - bucket_num / 2));
+        bucket_us *= 2;
+        last_logged /= 2;
+        idx = (now - start_us) / bucket_us;
+    }
+    return idx;
+}
+
+esp_err_t soak_stats_start(const soak_stats_cfg_t *cfg)
+{
+    if (cfg->bucket_seconds <= 0 || cfg->max_buckets < 2) {
+        ESP_LOGE(TAG, "Bad configuration");
+        return ESP_FAIL;
+    }
+    soak_bucket_t *b = calloc(cfg->max_buckets, sizeof(soak_bucket_t));
+    if (b == NULL) {
+        ESP_LOGE(TAG, "No memory for %d buckets", cfg->max_buckets);
+        return ESP_FAIL;
+    }
+    soak_bucket_t *old = buckets;
+    portENTER_CRITICAL(&lock);
+    buckets = b;
+    bucket_num = cfg->max_buckets & ~1;
+    bucket_us = cfg->bucket_seconds * 1000000LL;
+    start_us = esp_timer_get_time();
+    last_logged = 0;
+    running = true;
+    portEXIT_CRITICAL(&lock);
+    free(old);
+    return ESP_OK;
+}
+
+void soak_stats_record(soak_metric_t metric, uint32_t value)
+{
+    if (!running || metric >= SOAK_METRIC_MAX) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    if (running) {
+        _hist_add(&buckets[_bucket_index(now)].m[metric], value);
+    }
+    portEXIT_CRITICAL(&lock);
+}
+
+static void _log_bucket(int idx, const soak_bucket_t *b, int64_t len_us)
+{
+    const soak_hist_t *w = &b->m[SOAK_WRITE_US];
+    const soak_hist_t *e = &b->m[SOAK_ENCODE_US];
+    char enc[48] = "";
+    if (e->count) {
+        snprintf(enc, sizeof(enc), ", encode mean %u max %u us", (unsigned)_hist_mean(e), (unsigned)e->max);
+    }
+    ESP_LOGI(TAG, "%6lld s +%lld: write mean %u max %u us%s, rb max %u, heap min %u, block min %u",
+             idx * len_us / 1000000, len_us / 1000000, (unsigned)_hist_mean(w), (unsigned)w->max, enc,
+             (unsigned)b->m[SOAK_RB_FILL].max, (unsigned)b->m[SOAK_FREE_HEAP].min,
+             (unsigned)b->m[SOAK_LARGEST_BLOCK].min);
+}
+
+void soak_stats_tick(void)
+{
+    if (!running) {
+        return;
+    }
+    soak_stats_record(SOAK_FREE_HEAP, esp_get_free_heap_size());
+    soak_stats_record(SOAK_LARGEST_BLOCK, heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    soak_bucket_t done;
+    int64_t len_us;
+    int idx = -1;
+    portENTER_CRITICAL(&lock);
+    if (running && _bucket_index(esp_timer_get_time()) > last_logged) {
+        idx = last_logged++;
+        done = buckets[idx];
+        len_us = bucket_us;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (idx >= 0) {
+        _log_bucket(idx, &done, len_us);
+    }
+}
+
+// the value a metric degrades in: latency and fill creep up, heap creeps down
+static uint32_t _trend_key(soak_metric_t m, const soak_hist_t *h)
+{
+    switch (m) {
+        case SOAK_RB_FILL:
+            return h->max;
+        case SOAK_FREE_HEAP:
+        case SOAK_LARGEST_BLOCK:
+            return h->min;
+        default:
+            return _hist_mean(h);
+    }
+}
+
+static void _report_trend(const char *scenario, soak_metric_t m, int used, int64_t now_us)
+{
+    // least squares line through the key value of every bucket that has samples
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, x_first = 0, x_last = 0;
+    int n = 0;
+    for (int i = 0; i < used; i++) {
+        const soak_hist_t *h = &buckets[i].m[m];
+        if (h->count == 0) {
+            continue;
+        }
+        int64_t end = (i + 1) * bucket_us < now_us ? (i + 1) * bucket_us : now_us;
+        double x = (i * bucket_us + end) / 2e6;
+        double y = _trend_key(m, h);
+        if (n == 0) {
+            x_first = x;
+        }
+        x_last = x;
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        n++;
+    }
+    if (n == 0) {
+        return;
+    }
+    if (n < 3) {
+        ESP_LOGI(TAG, "%s: %-13s %d buckets, too short for a trend", scenario, metric_names[m], n);
+        return;
+    }
+    double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    double first = (sy - slope * sx) / n + slope * x_first;
+    if (first <= 0) {
+        first = sy / n;
+    }
+    double change_pct = first > 0 ? slope * (x_last - x_first) / first * 100 : 0;
+    bool worse_up = m != SOAK_FREE_HEAP && m != SOAK_LARGEST_BLOCK;
+    double bad_pct = worse_up ? change_pct : -change_pct;
+    const char *verdict = bad_pct > SOAK_STATS_DRIFT_PCT ? "degrading" : "stable";
+    ESP_LOGI(TAG, "%s: %-13s %.0f -> %.0f, %+.1f per hour, %+.1f%% over the run, %s", scenario, metric_names[m],
+             first, first + slope * (x_last - x_first), slope * 3600, change_pct, verdict);
+    printf("SOAK_TREND,%s,%s,%d,%.3f,%.2f,%s\n", scenario, metric_names[m], n, slope * 3600, change_pct, verdict);
+}
+
+void soak_stats_report(const char *scenario)
+{
+    if (buckets == NULL) {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    running = false;
+    portEXIT_CRITICAL(&lock);
+    int64_t now_us = esp_timer_get_time() - start_us;
+    int used = now_us / bucket_us + 1;
+    if (used > bucket_num) {
+        used = bucket_num;
+    }
+    ESP_LOGI(TAG, "%s: %.1f min in %d buckets of %lld s", scenario, now_us / 6e7f, used, bucket_us / 1000000);
+    for (int i = 0; i < used; i++) {
+        _log_bucket(i, &buckets[i], bucket_us);
+        // one row per bucket and metric: start s, count, min, mean, p50, p99, max
+        for (int m = 0; m < SOAK_METRIC_MAX; m++) {
+            const soak_hist_t *h = &buckets[i].m[m];
+            if (h->count == 0) {
+                continue;
+            }
+            printf("SOAK,%s,%s,%lld,%u,%u,%u,%u,%u,%u\n", scenario, metric_names[m], i * bucket_us / 1000000,
+                   (unsigned)h->count, (unsigned)h->min, (unsigned)_hist_mean(h),
+                   (unsigned)_hist_quantile(h, 0.5f), (unsigned)_hist_quantile(h, 0.99f), (unsigned)h->max);
+        }
+    }
+    for (int m = 0; m < SOAK_METRIC_MAX; m++) {
+        _report_trend(scenario, m, used, now_us);
+    }
+}
+
+void soak_stats_stop(void)
+{
+    portENTER_CRITICAL(&lock);
+    running = false;
+    soak_bucket_t *b = buckets;
+    buckets = NULL;
+    portEXIT_CRITICAL(&lock);
+    free(b);
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef _SOAK_STATS_H_
+#define _SOAK_STATS_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Quantities tracked over a long run
+ */
+typedef enum {
+    SOAK_WRITE_US = 0,      /*!< Time one write() to the card took */
+    SOAK_ENCODE_US,         /*!< Encoder time per frame */
+    SOAK_RB_FILL,           /*!< Capture ringbuffer fill in bytes, the bucket max is its high water */
+    SOAK_FREE_HEAP,         /*!< Free heap, the bucket min is the low water */
+    SOAK_LARGEST_BLOCK,     /*!< Largest free block, falls below free heap as the heap fragments */
+    SOAK_METRIC_MAX,
+} soak_metric_t;
+
+/**
+ * @brief   Soak statistics configuration
+ *
+ *          Samples land in the bucket of the time they were recorded. When the run outlasts
+ *          max_buckets, neighbouring buckets are merged and the bucket length doubles, so
+ *          memory stays fixed however long the run is.
+ */
+typedef struct {
+    int     bucket_seconds;     /*!< Initial bucket length */
+    int     max_buckets;        /*!< Buckets kept, even */
+} soak_stats_cfg_t;
+
+#define SOAK_STATS_CFG_DEFAULT() {  \
+    .bucket_seconds = 300,          \
+    .max_buckets = 24,              \
+}
+
+/* A metric whose trend line moves this much over the run in the bad direction is reported as degrading */
+#define SOAK_STATS_DRIFT_PCT (20)
+
+/**
+ * @brief      Allocate the buckets and start the clock
+ *
+ * @param      cfg   The configuration
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t soak_stats_start(const soak_stats_cfg_t *cfg);
+
+/**
+ * @brief      Add one sample, from any task. Ignored before soak_stats_start
+ *
+ * @param      metric  The metric
+ * @param      value   The sample
+ */
+void soak_stats_record(soak_metric_t metric, uint32_t value);
+
+/**
+ * @brief      Sample the heap and log each bucket as it completes, call about once a second
+ */
+void soak_stats_tick(void);
+
+/**
+ * @brief      Log every bucket and the trend of every metric, print SOAK,... CSV lines
+ *
+ * @param      scenario  Name used in the log and CSV
+ */
+void soak_stats_report(const char *scenario);
+
+/**
+ * @brief      Free the buckets
+ */
+void soak_stats_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,614 @@
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "spool_stream.h"
+
+static const char *TAG = "SPOOL_STREAM";
+
+#define SPOOL_HELLO_LEN (12)
+#define SPOOL_COUNT_LEN (8)
+
+typedef struct spool_stream {
+    spool_stream_cfg_t  cfg;
+    int                 sock;
+    int                 fd;             /*!< Circular log, only ever read and written at an offset */
+    int                 head;           /*!< Oldest unacknowledged byte of the log */
+    bool                appending;      /*!< The element is writing past the log end without the lock */
+    char                *win;           /*!< Live data, older than anything in the log */
+    int                 win_head;
+    int64_t             sent_pos;       /*!< Stream offset of the next byte to send on this connection */
+    int64_t             inflight_at_drop;
+    uint64_t            session;
+    bool                resumed;        /*!< The receiver has told where to resume */
+    bool                drop_link;      /*!< Any task may ask, only the sender closes the socket */
+    uint8_t             count_buf[SPOOL_COUNT_LEN];
+    int                 count_fill;
+    int64_t             connected_at_us;
+    int64_t             outage_until_us;
+    int64_t             recovered_at_us;
+    bool                running;
+    char                *send_buf;
+    SemaphoreHandle_t   lock;
+    SemaphoreHandle_t   sender_exit;
+    TaskHandle_t        sender;
+    spool_stream_stats_t stats;
+} spool_stream_t;
+
+static void _put_be64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--) {
+        p[i] = v & 0xff;
+        v >>= 8;
+    }
+}
+
+static uint64_t _get_be64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static int _win_append(spool_stream_t *s, const char *data, int len)
+{
+    int space = s->cfg.ack_window - s->stats.window;
+    int total = len < space ? len : space;
+    int done = 0;
+    while (done < total) {
+        int tail = (s->win_head + s->stats.window) % s->cfg.ack_window;
+        int n = total - done;
+        if (n > s->cfg.ack_window - tail) {
+            n = s->cfg.ack_window - tail;
+        }
+        memcpy(s->win + tail, data + done, n);
+        done += n;
+        s->stats.window += n;
+    }
+    return done;
+}
+
+// element task only. The space past the log end is reserved under the lock and written
+// without it, so the sender and the receiver's counts never wait on the card
+static int _spool_append(spool_stream_t *s, const char *data, int len)
+{
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    int space = s->cfg.spool_size - s->stats.depth;
+    int tail = (s->head + s->stats.depth) % s->cfg.spool_size;
+    s->appending = true;
+    xSemaphoreGive(s->lock);
+
+    // acknowledgements meanwhile move head and depth together, the reserved tail stays put
+    int total = len < space ? len : space;
+    int done = 0;
+    while (done < total) {
+        int n = total - done;
+        if (n > s->cfg.spool_size - tail) {
+            n = s->cfg.spool_size - tail;
+        }
+        if (pwrite(s->fd, data + done, n, tail) != n) {
+            ESP_LOGE(TAG, "Spool write failed at %d", tail);
+            break;
+        }
+        done += n;
+        tail = (tail + n) % s->cfg.spool_size;
+    }
+
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->appending = false;
+    s->stats.depth += done;
+    if (s->stats.depth > s->stats.depth_high_water) {
+        s->stats.depth_high_water = s->stats.depth;
+    }
+    xSemaphoreGive(s->lock);
+    return done;
+}
+
+// sender task only, without the lock. The caller drops the data if it was acknowledged meanwhile
+static int _spool_read(spool_stream_t *s, int pos, int len)
+{
+    if (pread(s->fd, s->send_buf, len, pos) != len) {
+        ESP_LOGE(TAG, "Spool read failed at %d", pos);
+        return 0;
+    }
+    return len;
+}
+
+// next unsent piece, from the window first as it holds the older data. A piece of the log is
+// only located, *log_pos tells the sender where to read it once the lock is released
+static int _next_chunk(spool_stream_t *s, const char **data, int *log_pos)
+{
+    int off = s->sent_pos - s->stats.bytes_acked;
+    if (off < s->stats.window) {
+        int pos = (s->win_head + off) % s->cfg.ack_window;
+        int n = s->stats.window - off;
+        if (n > s->cfg.ack_window - pos) {
+            n = s->cfg.ack_window - pos;
+        }
+        *data = s->win + pos;
+        return n;
+    }
+    off -= s->stats.window;
+    int n = s->stats.depth - off < s->cfg.buffer_len ? s->stats.depth - off : s->cfg.buffer_len;
+    int pos = (s->head + off) % s->cfg.spool_size;
+    if (n > s->cfg.spool_size - pos) {
+        n = s->cfg.spool_size - pos;
+    }
+    if (n <= 0) {
+        return 0;
+    }
+    *data = s->send_buf;
+    *log_pos = pos;
+    return n;
+}
+
+static void _release(spool_stream_t *s, int len)
+{
+    int n = len < s->stats.window ? len : s->stats.window;
+    s->win_head = (s->win_head + n) % s->cfg.ack_window;
+    s->stats.window -= n;
+    s->stats.depth -= len - n;
+    s->head = (s->head + len - n) % s->cfg.spool_size;
+    s->stats.bytes_acked += len;
+    if (s->sent_pos < s->stats.bytes_acked) {
+        s->sent_pos = s->stats.bytes_acked;
+    }
+    if (s->stats.depth == 0 && !s->appending) {
+        // restart at the beginning of the file so an idle spool keeps hitting the same clusters
+        s->head = 0;
+    }
+    if (s->stats.depth == 0 && s->stats.window == 0 && s->recovered_at_us) {
+        s->stats.last_catch_up_ms = (esp_timer_get_time() - s->recovered_at_us) / 1000;
+        if (s->stats.last_catch_up_ms > s->stats.max_catch_up_ms) {
+            s->stats.max_catch_up_ms = s->stats.last_catch_up_ms;
+        }
+        s->recovered_at_us = 0;
+        ESP_LOGI(TAG, "Backlog acknowledged %d ms after reconnecting", s->stats.last_catch_up_ms);
+    }
+}
+
+// called with the lock held for every count the receiver sends
+static void _receiver_has(spool_stream_t *s, int64_t have)
+{
+    int64_t acked = s->stats.bytes_acked;
+    if (have < acked || have > acked + s->stats.window + s->stats.depth) {
+        ESP_LOGE(TAG, "Receiver holds %lld bytes, %lld acknowledged and %d kept, dropping the connection",
+                 have, acked, s->stats.window + s->stats.depth);
+        s->drop_link = true;
+        return;
+    }
+    if (!s->resumed) {
+        s->resumed = true;
+        s->stats.connected = 1;
+        s->stats.reconnects++;
+        if (s->stats.depth + s->stats.window > 0) {
+            s->recovered_at_us = esp_timer_get_time();
+        }
+        if (s->inflight_at_drop > have - acked) {
+            s->stats.bytes_resent += s->inflight_at_drop - (have - acked);
+        }
+        s->inflight_at_drop = 0;
+        ESP_LOGI(TAG, "Receiver holds %lld bytes, resuming with %lld kept", have,
+                 acked + s->stats.window + s->stats.depth - have);
+    }
+    _release(s, have - acked);
+}
+
+static void _count_sent(spool_stream_t *s, int sent)
+{
+    if (s->stats.bytes_sent == 0) {
+        s->stats.first_send_us = esp_timer_get_time();
+    }
+    s->stats.bytes_sent += sent;
+    s->sent_pos += sent;
+}
+
+static void _update_latency(spool_stream_t *s, int64_t latency_us)
+{
+    s->stats.send_latency_us = (s->stats.send_latency_us * 7 + (int)latency_us) / 8;
+}
+
+// sender task only, nothing else may close a socket the sender can be waiting on
+static void _link_down(spool_stream_t *s)
+{
+    s->drop_link = false;
+    if (s->sock < 0) {
+        return;
+    }
+    close(s->sock);
+    s->sock = -1;
+    if (!s->resumed) {
+        return;
+    }
+    s->resumed = false;
+    s->stats.connected = 0;
+    s->stats.outages++;
+    s->recovered_at_us = 0;
+    // whatever lwIP held is gone with the socket, the receiver says how much of it arrived
+    s->inflight_at_drop = s->sent_pos - s->stats.bytes_acked;
+    s->sent_pos = s->stats.bytes_acked;
+    ESP_LOGW(TAG, "Link down, %lld bytes unacknowledged, spooling to %s", s->inflight_at_drop, s->cfg.spool_path);
+}
+
+static int _connect(spool_stream_t *s)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo *res = NULL;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", s->cfg.port);
+    if (getaddrinfo(s->cfg.host, port, &hints, &res) != 0 || res == NULL) {
+        return -1;
+    }
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock < 0) {
+        freeaddrinfo(res);
+        return -1;
+    }
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    int ret = connect(sock, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (ret != 0 && errno != EINPROGRESS) {
+        close(sock);
+        return -1;
+    }
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    FD_SET(sock, &wfds);
+    struct timeval tv = {
+        .tv_sec = s->cfg.connect_timeout_ms / 1000,
+        .tv_usec = (s->cfg.connect_timeout_ms % 1000) * 1000,
+    };
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (select(sock + 1, NULL, &wfds, NULL, &tv) <= 0
+        || getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+        close(sock);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    uint8_t hello[SPOOL_HELLO_LEN] = {'S', 'P', 'L', '1'};
+    _put_be64(hello + 4, s->session);
+    if (send(sock, hello, sizeof(hello), MSG_DONTWAIT) != sizeof(hello)) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// called with the lock held when the socket is readable
+static void _read_counts(spool_stream_t *s, int sock)
+{
+    while (!s->drop_link) {
+        int n = recv(sock, s->count_buf + s->count_fill, SPOOL_COUNT_LEN - s->count_fill, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            s->drop_link = true;
+            break;
+        }
+        if (n < 0) {
+            break;
+        }
+        s->count_fill += n;
+        if (s->count_fill == SPOOL_COUNT_LEN) {
+            s->count_fill = 0;
+            _receiver_has(s, _get_be64(s->count_buf));
+        }
+    }
+}
+
+static void _spool_sender(void *arg)
+{
+    spool_stream_t *s = (spool_stream_t *)arg;
+    while (s->running) {
+        if (s->drop_link) {
+            xSemaphoreTake(s->lock, portMAX_DELAY);
+            bool was_up = s->resumed;
+            _link_down(s);
+            xSemaphoreGive(s->lock);
+            if (!was_up) {
+                // the receiver took the connection but never answered, do not hammer it
+                vTaskDelay(s->cfg.reconnect_interval_ms / portTICK_PERIOD_MS);
+            }
+        }
+        if (s->sock < 0) {
+            if (esp_timer_get_time() < s->outage_until_us) {
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+                continue;
+            }
+            int sock = _connect(s);
+            if (sock < 0) {
+                vTaskDelay(s->cfg.reconnect_interval_ms / portTICK_PERIOD_MS);
+                continue;
+            }
+            xSemaphoreTake(s->lock, portMAX_DELAY);
+            s->sock = sock;
+            s->count_fill = 0;
+            s->connected_at_us = esp_timer_get_time();
+            xSemaphoreGive(s->lock);
+            ESP_LOGI(TAG, "Connected to %s:%d, %d bytes kept", s->cfg.host, s->cfg.port,
+                     s->stats.depth + s->stats.window);
+            continue;
+        }
+
+        const char *data = NULL;
+        int n = 0;
+        int log_pos = -1;
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+        int sock = s->sock;
+        int64_t pos = s->sent_pos;
+        bool resumed = s->resumed;
+        if (resumed) {
+            n = _next_chunk(s, &data, &log_pos);
+        }
+        xSemaphoreGive(s->lock);
+        if (n > 0 && log_pos >= 0) {
+            n = _spool_read(s, log_pos, n);
+        }
+        if (!resumed && esp_timer_get_time() - s->connected_at_us > s->cfg.connect_timeout_ms * 1000LL) {
+            ESP_LOGW(TAG, "No resume offset from the receiver");
+            s->drop_link = true;
+            continue;
+        }
+
+        int64_t start = esp_timer_get_time();
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(sock, &rfds);
+        if (n > 0) {
+            FD_SET(sock, &wfds);
+        }
+        // live data is sent by the element itself, idle polls only pick up counts
+        struct timeval tv = {
+            .tv_sec = 0,
+            .tv_usec = (n > 0 ? 100 : 20) * 1000,
+        };
+        int ready = select(sock + 1, &rfds, n > 0 ? &wfds : NULL, NULL, &tv);
+        if (ready < 0) {
+            s->drop_link = true;
+            continue;
+        }
+        if (ready == 0) {
+            continue;
+        }
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+        if (FD_ISSET(sock, &rfds)) {
+            _read_counts(s, sock);
+        }
+        if (n > 0 && FD_ISSET(sock, &wfds) && !s->drop_link && s->sent_pos == pos) {
+            int sent = send(sock, data, n, MSG_DONTWAIT);
+            if (sent > 0) {
+                _count_sent(s, sent);
+                _update_latency(s, esp_timer_get_time() - start);
+            } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                s->drop_link = true;
+            }
+        }
+        xSemaphoreGive(s->lock);
+    }
+    xSemaphoreGive(s->sender_exit);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t _spool_open(audio_element_handle_t self)
+{
+    spool_stream_t *s = (spool_stream_t *)audio_element_getdata(self);
+    if (s->fd >= 0) {
+        return ESP_OK;
+    }
+    s->fd = open(s->cfg.spool_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (s->fd < 0) {
+        ESP_LOGE(TAG, "Failed to open spool file %s", s->cfg.spool_path);
+        return ESP_FAIL;
+    }
+    s->send_buf = audio_malloc(s->cfg.buffer_len);
+    s->win = audio_malloc(s->cfg.ack_window);
+    AUDIO_MEM_CHECK(TAG, s->send_buf && s->win, goto _spool_open_exit);
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->head = 0;
+    s->win_head = 0;
+    s->sent_pos = 0;
+    s->inflight_at_drop = 0;
+    s->appending = false;
+    s->session = ((uint64_t)esp_random() << 32) | esp_random();
+    s->resumed = false;
+    s->drop_link = false;
+    s->sock = -1;
+    s->running = true;
+    if (xTaskCreatePinnedToCore(_spool_sender, "spool_tx", 3 * 1024, s, s->cfg.task_prio - 1,
+                                &s->sender, s->cfg.task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create sender task");
+        s->running = false;
+        goto _spool_open_exit;
+    }
+    return ESP_OK;
+
+_spool_open_exit:
+    audio_free(s->send_buf);
+    s->send_buf = NULL;
+    audio_free(s->win);
+    s->win = NULL;
+    close(s->fd);
+    s->fd = -1;
+    return ESP_FAIL;
+}
+
+static int _spool_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    spool_stream_t *s = (spool_stream_t *)audio_element_getdata(self);
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if (r_size <= 0) {
+        return r_size;
+    }
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    bool all_sent = s->sent_pos == s->stats.bytes_acked + s->stats.window + s->stats.depth;
+    // live data may only go to the window when nothing older is still waiting in the log
+    int live = s->stats.depth == 0 ? _win_append(s, in_buffer, r_size) : 0;
+    if (live > 0 && all_sent && s->resumed && s->sock >= 0 && !s->drop_link) {
+        int sent = send(s->sock, in_buffer, live, MSG_DONTWAIT);
+        if (sent > 0) {
+            _count_sent(s, sent);
+            if (sent == r_size) {
+                _update_latency(s, 0);
+            }
+        } else if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            s->drop_link = true;
+        }
+    }
+    xSemaphoreGive(s->lock);
+
+    int spooled = live < r_size ? _spool_append(s, in_buffer + live, r_size - live) : 0;
+    int kept = live + spooled;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->stats.bytes_in += r_size;
+    s->stats.bytes_spooled += spooled;
+    s->stats.bytes_dropped += r_size - kept;
+    s->stats.stream_crc = esp_rom_crc32_le(s->stats.stream_crc, (const uint8_t *)in_buffer, kept);
+    xSemaphoreGive(s->lock);
+    audio_element_update_byte_pos(self, r_size);
+    return r_size;
+}
+
+static esp_err_t _spool_close(audio_element_handle_t self)
+{
+    spool_stream_t *s = (spool_stream_t *)audio_element_getdata(self);
+    // a pause keeps the session, the sender goes on draining what is kept
+    if (s->fd < 0 || AEL_STATE_PAUSED == audio_element_get_state(self)) {
+        return ESP_OK;
+    }
+    int64_t deadline = esp_timer_get_time() + (int64_t)s->cfg.drain_timeout_ms * 1000;
+    while (esp_timer_get_time() < deadline) {
+        xSemaphoreTake(s->lock, portMAX_DELAY);
+        int kept = s->stats.depth + s->stats.window;
+        xSemaphoreGive(s->lock);
+        if (kept == 0) {
+            break;
+        }
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+    }
+    s->running = false;
+    xSemaphoreTake(s->sender_exit, portMAX_DELAY);
+    if (s->sock >= 0) {
+        shutdown(s->sock, SHUT_RDWR);
+        close(s->sock);
+        s->sock = -1;
+    }
+    close(s->fd);
+    s->fd = -1;
+    audio_free(s->send_buf);
+    s->send_buf = NULL;
+    audio_free(s->win);
+    s->win = NULL;
+    spool_stream_stats_t stats;
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    memcpy(&stats, &s->stats, sizeof(stats));
+    xSemaphoreGive(s->lock);
+    spool_stream_stats_t *st = &stats;
+    ESP_LOGI(TAG, "in %lld, sent %lld, acknowledged %lld, resent %lld, spooled %lld, dropped %lld, left %d, high water %d, outages %d, max catch up %d ms",
+             st->bytes_in, st->bytes_sent, st->bytes_acked, st->bytes_resent, st->bytes_spooled, st->bytes_dropped,
+             st->depth + st->window, st->depth_high_water, st->outages, st->max_catch_up_ms);
+    ESP_LOGI(TAG, "Session %016llx: %lld bytes, crc32 %08x", s->session, st->bytes_in - st->bytes_dropped,
+             (unsigned)st->stream_crc);
+    if (st->bytes_acked == st->bytes_in) {
+        ESP_LOGI(TAG, "Zero loss: the receiver acknowledged every byte from the pipeline");
+    } else {
+        ESP_LOGW(TAG, "Data loss: %lld bytes not acknowledged by the receiver", st->bytes_in - st->bytes_acked);
+    }
+    audio_element_report_info(self);
+    audio_element_set_byte_pos(self, 0);
+    return ESP_OK;
+}
+
+static esp_err_t _spool_destroy(audio_element_handle_t self)
+{
+    spool_stream_t *s = (spool_stream_t *)audio_element_getdata(self);
+    vSemaphoreDelete(s->lock);
+    vSemaphoreDelete(s->sender_exit);
+    audio_free(s);
+    return ESP_OK;
+}
+
+esp_err_t spool_stream_get_stats(audio_element_handle_t self, spool_stream_stats_t *stats)
+{
+    spool_stream_t *s = (spool_stream_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, s, return ESP_FAIL);
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    memcpy(stats, &s->stats, sizeof(*stats));
+    xSemaphoreGive(s->lock);
+    return ESP_OK;
+}
+
+esp_err_t spool_stream_inject_outage(audio_element_handle_t self, int duration_ms)
+{
+    spool_stream_t *s = (spool_stream_t *)audio_element_getdata(self);
+    AUDIO_NULL_CHECK(TAG, s, return ESP_FAIL);
+    xSemaphoreTake(s->lock, portMAX_DELAY);
+    s->outage_until_us = esp_timer_get_time() + (int64_t)duration_ms * 1000;
+    s->drop_link = true;
+    xSemaphoreGive(s->lock);
+    ESP_LOGW(TAG, "Injected %d ms outage", duration_ms);
+    return ESP_OK;
+}
+
+audio_element_handle_t spool_stream_init(spool_stream_cfg_t *config)
+{
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    AUDIO_NULL_CHECK(TAG, config->host, return NULL);
+    if (config->ack_window <= 0) {
+        ESP_LOGE(TAG, "Bad ack window %d", config->ack_window);
+        return NULL;
+    }
+    spool_stream_t *s = audio_calloc(1, sizeof(spool_stream_t));
+    AUDIO_MEM_CHECK(TAG, s, return NULL);
+    memcpy(&s->cfg, config, sizeof(spool_stream_cfg_t));
+    s->sock = -1;
+    s->fd = -1;
+    s->lock = xSemaphoreCreateMutex();
+    s->sender_exit = xSemaphoreCreateBinary();
+    AUDIO_MEM_CHECK(TAG, s->lock, goto _spool_init_exit);
+    AUDIO_MEM_CHECK(TAG, s->sender_exit, goto _spool_init_exit);
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _spool_open;
+    cfg.close = _spool_close;
+    cfg.process = _spool_process;
+    cfg.destroy = _spool_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.buffer_len = config->buffer_len;
+    cfg.tag = "spool";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, goto _spool_init_exit);
+    audio_element_setdata(el, s);
+    return el;
+
+_spool_init_exit:
+    if (s->lock) {
+        vSemaphoreDelete(s->lock);
+    }
+    if (s->sender_exit) {
+        vSemaphoreDelete(s->sender_exit);
+    }
+    audio_free(s);
+    return NULL;
+}
\ No newline at end of file
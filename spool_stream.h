@@ -0,0 +1,120 @@
+#ifndef _SPOOL_STREAM_H_
+#define _SPOOL_STREAM_H_
+
+#include "audio_element.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Spool stream configuration
+ *
+ *          The spool stream is a TCP writer that never blocks its input. Live data is held
+ *          in a RAM window, and whatever does not fit there is appended to a bounded circular
+ *          log on the sdcard. Nothing is released until the receiver acknowledges it, so data
+ *          lwIP accepted but never delivered before a link drop is sent again. The log is
+ *          read and written at offsets reserved under the stream's lock but outside it, so
+ *          the input only waits on its own appends; FatFs still runs one call per volume at a
+ *          time, which can put one sender read of buffer_len ahead of an append.
+ *
+ *          Protocol, all numbers big endian: on every connection the stream sends "SPL1" and
+ *          a 64-bit session id, the receiver answers with the 64-bit count of bytes it already
+ *          holds for that session and from then on sends that count again as it grows. The
+ *          stream resumes from the first count, tools/spool_receiver.py implements the receiver.
+ */
+typedef struct {
+    const char  *host;                  /*!< Server address */
+    int         port;                   /*!< Server port */
+    const char  *spool_path;            /*!< Circular log file, the sdcard must be mounted before open */
+    int         spool_size;             /*!< Size of the circular log in bytes */
+    int         connect_timeout_ms;     /*!< Timeout of one connection attempt */
+    int         reconnect_interval_ms;  /*!< Pause between connection attempts */
+    int         drain_timeout_ms;       /*!< How long close waits for the backlog to be acknowledged */
+    int         ack_window;             /*!< RAM for live data awaiting acknowledgement */
+    int         buffer_len;             /*!< Element and sender buffer size */
+    int         task_stack;             /*!< Element task stack */
+    int         task_core;              /*!< Element and sender task core */
+    int         task_prio;              /*!< Element task priority, the sender runs one below */
+} spool_stream_cfg_t;
+
+/**
+ * @brief   Spool stream counters, all byte counts are since the element was opened
+ */
+typedef struct {
+    int64_t     bytes_in;               /*!< Bytes received from the pipeline */
+    int64_t     bytes_sent;             /*!< Bytes accepted by the socket, resends included */
+    int64_t     bytes_acked;            /*!< Bytes the receiver confirmed it holds */
+    int64_t     bytes_resent;           /*!< Bytes accepted by the socket but missing at the receiver after a reconnect */
+    int64_t     bytes_spooled;          /*!< Bytes that went through the circular log */
+    int64_t     bytes_dropped;          /*!< Bytes lost because the window and the circular log were full */
+    uint32_t    stream_crc;             /*!< CRC32 of every byte not dropped, compare with the receiver */
+    int         window;                 /*!< Live bytes held in RAM until acknowledged */
+    int         depth;                  /*!< Bytes in the circular log, sent or not, until acknowledged */
+    int         depth_high_water;       /*!< Largest depth seen */
+    int         send_latency_us;        /*!< Smoothed time the socket took to accept data, 0 while it keeps up */
+    int         connected;              /*!< 1 while a connection is up and resumed */
+    int         outages;                /*!< Number of times the link went down */
+    int         reconnects;             /*!< Number of successful connections */
+    int         last_catch_up_ms;       /*!< Time from reconnect until the backlog was empty */
+    int         max_catch_up_ms;        /*!< Largest catch up time */
+    int64_t     first_send_us;          /*!< esp_timer time of the first byte sent, 0 until then */
+} spool_stream_stats_t;
+
+#define SPOOL_STREAM_TASK_STACK     (4 * 1024)
+#define SPOOL_STREAM_TASK_CORE      (0)
+#define SPOOL_STREAM_TASK_PRIO      (5)
+#define SPOOL_STREAM_BUF_SIZE       (4 * 1024)
+#define SPOOL_STREAM_SPOOL_SIZE     (4 * 1024 * 1024)
+#define SPOOL_STREAM_ACK_WINDOW     (32 * 1024)
+
+#define SPOOL_STREAM_CFG_DEFAULT() {                \
+    .host = NULL,                                   \
+    .port = 8000,                                   \
+    .spool_path = "/sdcard/spool.bin",              \
+    .spool_size = SPOOL_STREAM_SPOOL_SIZE,          \
+    .connect_timeout_ms = 500,                      \
+    .reconnect_interval_ms = 1000,                  \
+    .drain_timeout_ms = 30000,                      \
+    .ack_window = SPOOL_STREAM_ACK_WINDOW,          \
+    .buffer_len = SPOOL_STREAM_BUF_SIZE,            \
+    .task_stack = SPOOL_STREAM_TASK_STACK,          \
+    .task_core = SPOOL_STREAM_TASK_CORE,            \
+    .task_prio = SPOOL_STREAM_TASK_PRIO,            \
+}
+
+/**
+ * @brief      Create a spool stream writer
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL on failure
+ */
+audio_element_handle_t spool_stream_init(spool_stream_cfg_t *config);
+
+/**
+ * @brief      Read the current counters
+ *
+ * @param      self   The spool stream handle
+ * @param      stats  Filled with a consistent snapshot
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t spool_stream_get_stats(audio_element_handle_t self, spool_stream_stats_t *stats);
+
+/**
+ * @brief      Treat the link as down for a while, to test recovery without touching the AP.
+ *             The sender task drops the connection, unacknowledged data goes out again later
+ *
+ * @param      self         The spool stream handle
+ * @param      duration_ms  Outage length
+ *
+ * @return     ESP_OK or ESP_FAIL
+ */
+esp_err_t spool_stream_inject_outage(audio_element_handle_t self, int duration_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
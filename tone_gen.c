@@ -0,0 +1,211 @@
+#include <string.h>
+#include "tone_gen.h"
+
+#define TONE_GEN_DEFAULT_SEED (0x2545F491)
+#define TONE_GEN_SYLLABLE_HZ (4)
+
+// sin(pi/2 * z) ~ z * (a - z^2 * (b - z^2 * c)), exact at 0 and 1, in Q15
+#define SIN_A (51472)
+#define SIN_B (21023)
+#define SIN_C (2320)
+
+int16_t tone_gen_sin(uint32_t phase)
+{
+    uint32_t angle = phase >> 16;
+    uint32_t quadrant = angle >> 14;
+    int64_t r = angle & 0x3FFF;
+    if (quadrant & 1) {
+        r = 0x4000 - r;
+    }
+    int64_t z = r << 1;
+    int64_t z2 = (z * z) >> 15;
+    int64_t t = SIN_B - ((z2 * SIN_C) >> 15);
+    t = SIN_A - ((z2 * t) >> 15);
+    int64_t y = (z * t) >> 15;
+    if (y > 32767) {
+        y = 32767;
+    }
+    return (int16_t)(quadrant & 2 ? -y : y);
+}
+
+static uint32_t phase_inc(int freq_hz, int sample_rate)
+{
+    return (uint32_t)(((uint64_t)freq_hz << 32) / sample_rate);
+}
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int32_t white(tone_gen_t *gen)
+{
+    return (int32_t)(xorshift32(&gen->rng) >> 16) - 32768;
+}
+
+// Voss-McCartney: row k is refreshed every 2^k samples
+static int32_t pink(tone_gen_t *gen)
+{
+    gen->counter++;
+    uint32_t c = gen->counter;
+    int row = 0;
+    while ((c & 1) == 0 && row < 7) {
+        c >>= 1;
+        row++;
+    }
+    int32_t v = white(gen);
+    gen->row_sum += v - gen->rows[row];
+    gen->rows[row] = v;
+    // nine rows of full scale white noise, scaled to about -13 dBFS rms
+    int32_t s = (gen->row_sum + white(gen)) / 8;
+    if (s > 32767) {
+        s = 32767;
+    } else if (s < -32767) {
+        s = -32767;
+    }
+    return s;
+}
+
+static uint32_t rd16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int parse_wav(tone_gen_t *gen)
+{
+    const uint8_t *p = gen->cfg.wav;
+    size_t len = gen->cfg.wav_len;
+    if (p == NULL || len < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0) {
+        return -1;
+    }
+    size_t off = 12;
+    int fmt_ok = 0;
+    while (off + 8 <= len) {
+        uint32_t size = rd32(p + off + 4);
+        const uint8_t *body = p + off + 8;
+        if (size > len - off - 8) {
+            return -1;
+        }
+        if (memcmp(p + off, "fmt ", 4) == 0 && size >= 16) {
+            // PCM, 16 bit, no resampling
+            if (rd16(body) != 1 || rd16(body + 14) != 16 || rd32(body + 4) != (uint32_t)gen->cfg.sample_rate) {
+                return -1;
+            }
+            gen->pcm_channels = rd16(body + 2);
+            fmt_ok = gen->pcm_channels > 0;
+        } else if (memcmp(p + off, "data", 4) == 0 && fmt_ok) {
+            gen->pcm = body;
+            gen->pcm_frames = size / (2 * gen->pcm_channels);
+            return gen->pcm_frames > 0 ? 0 : -1;
+        }
+        off += 8 + size + (size & 1);
+    }
+    return -1;
+}
+
+int tone_gen_init(tone_gen_t *gen, const tone_gen_cfg_t *cfg)
+{
+    memset(gen, 0, sizeof(*gen));
+    gen->cfg = *cfg;
+    if (cfg->sample_rate <= 0 || cfg->channels <= 0 || cfg->amplitude < 0 || cfg->amplitude > 32767) {
+        return -1;
+    }
+    gen->rng = cfg->seed ? cfg->seed : TONE_GEN_DEFAULT_SEED;
+    switch (cfg->type) {
+        case TONE_GEN_SINE:
+            gen->inc = phase_inc(cfg->freq_hz, cfg->sample_rate);
+            break;
+        case TONE_GEN_CHIRP:
+            gen->inc = phase_inc(cfg->freq_hz, cfg->sample_rate);
+            gen->inc_end = phase_inc(cfg->freq_end_hz, cfg->sample_rate);
+            gen->period = (uint32_t)((int64_t)cfg->period_ms * cfg->sample_rate / 1000);
+            if (gen->period == 0) {
+                return -1;
+            }
+            break;
+        case TONE_GEN_BURST:
+            gen->inc = phase_inc(TONE_GEN_SYLLABLE_HZ, cfg->sample_rate);
+            gen->period = (uint32_t)((int64_t)(cfg->on_ms + cfg->off_ms) * cfg->sample_rate / 1000);
+            if (gen->period == 0) {
+                return -1;
+            }
+            break;
+        case TONE_GEN_WAV:
+            return parse_wav(gen);
+        case TONE_GEN_PINK:
+        case TONE_GEN_SILENCE:
+            break;
+        default:
+            return -1;
+    }
+    return 0;
+}
+
+static int32_t next_sample(tone_gen_t *gen)
+{
+    const tone_gen_cfg_t *cfg = &gen->cfg;
+    int32_t s = 0;
+    switch (cfg->type) {
+        case TONE_GEN_SINE:
+            s = tone_gen_sin(gen->phase);
+            gen->phase += gen->inc;
+            break;
+        case TONE_GEN_CHIRP: {
+            int64_t span = (int64_t)gen->inc_end - gen->inc;
+            s = tone_gen_sin(gen->phase);
+            gen->phase += (uint32_t)(gen->inc + span * gen->pos / gen->period);
+            if (++gen->pos >= gen->period) {
+                gen->pos = 0;
+            }
+            break;
+        }
+        case TONE_GEN_PINK:
+            s = pink(gen);
+            break;
+        case TONE_GEN_BURST: {
+            uint32_t on = (uint32_t)((int64_t)cfg->on_ms * cfg->sample_rate / 1000);
+            if (gen->pos < on) {
+                // raised sine starting at zero, one bump per syllable
+                int32_t env = (32767 - tone_gen_sin(gen->phase + 0x40000000u)) >> 1;
+                s = (pink(gen) * env) >> 15;
+                gen->phase += gen->inc;
+            } else {
+                gen->phase = 0;
+            }
+            if (++gen->pos >= gen->period) {
+                gen->pos = 0;
+            }
+            break;
+        }
+        case TONE_GEN_WAV:
+            // first channel of the file, looped
+            s = (int16_t)rd16(gen->pcm + (size_t)gen->pos * 2 * gen->pcm_channels);
+            if (++gen->pos >= gen->pcm_frames) {
+                gen->pos = 0;
+            }
+            return s;
+        default:
+            return 0;
+    }
+    return (s * cfg->amplitude) >> 15;
+}
+
+void tone_gen_fill(tone_gen_t *gen, int16_t *out, int frames)
+{
+    for (int i = 0; i < frames; i++) {
+        int16_t s = (int16_t)next_sample(gen);
+        for (int ch = 0; ch < gen->cfg.channels; ch++) {
+            *out++ = s;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef _TONE_GEN_H_
+#define _TONE_GEN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Test signal shapes
+ *
+ *          Everything is computed in integer arithmetic, so a given configuration
+ *          produces the same bytes on the ESP32 and on a host build.
+ */
+typedef enum {
+    TONE_GEN_SINE = 0,      /*!< Fixed sine at freq_hz */
+    TONE_GEN_CHIRP,         /*!< Linear sweep freq_hz -> freq_end_hz over period_ms, repeating */
+    TONE_GEN_PINK,          /*!< Pink noise */
+    TONE_GEN_SILENCE,       /*!< All zero */
+    TONE_GEN_BURST,         /*!< Pink noise with a syllable-rate envelope for on_ms, then off_ms of silence */
+    TONE_GEN_WAV,           /*!< 16 bit PCM WAV from memory, looped */
+} tone_gen_type_t;
+
+/* fft.c feeds pairs of real samples to the FFT as one complex point, so its
+ * detector bins 112..114 sit around 440 Hz at 16 kHz */
+#define TONE_GEN_FFT_TARGET_HZ (440)
+
+typedef struct {
+    tone_gen_type_t type;
+    int             sample_rate;
+    int             channels;       /*!< Output is interleaved, every channel gets the same sample */
+    int             amplitude;      /*!< Peak value, 0..32767 */
+    int             freq_hz;
+    int             freq_end_hz;
+    int             period_ms;      /*!< Chirp sweep length */
+    int             on_ms;          /*!< Burst length */
+    int             off_ms;         /*!< Silence between bursts */
+    uint32_t        seed;           /*!< Noise seed, 0 picks a fixed default */
+    const uint8_t   *wav;           /*!< WAV file image, e.g. from EMBED_FILES */
+    size_t          wav_len;
+} tone_gen_cfg_t;
+
+typedef struct {
+    tone_gen_cfg_t  cfg;
+    uint32_t        phase;
+    uint32_t        inc;
+    uint32_t        inc_end;
+    uint32_t        rng;
+    uint32_t        counter;
+    int32_t         rows[8];
+    int32_t         row_sum;
+    uint32_t        pos;            /*!< Samples into the current chirp or burst period */
+    uint32_t        period;         /*!< Chirp or burst period in samples */
+    const uint8_t   *pcm;           /*!< WAV data, little endian 16 bit */
+    uint32_t        pcm_frames;
+    int             pcm_channels;
+} tone_gen_t;
+
+/**
+ * @brief      Prepare a generator
+ *
+ * @param      gen   The generator
+ * @param      cfg   The configuration, WAV input is checked here
+ *
+ * @return     0 on success, -1 on a bad configuration or unsupported WAV
+ */
+int tone_gen_init(tone_gen_t *gen, const tone_gen_cfg_t *cfg);
+
+/**
+ * @brief      Produce the next frames
+ *
+ * @param      gen     The generator
+ * @param      out     Interleaved 16 bit output, frames * channels samples
+ * @param      frames  Number of frames
+ */
+void tone_gen_fill(tone_gen_t *gen, int16_t *out, int frames);
+
+/**
+ * @brief      Fixed point sine
+ *
+ * @param      phase  Full circle is 2^32
+ *
+ * @return     sin(phase) in Q15, -32767..32767
+ */
+int16_t tone_gen_sin(uint32_t phase);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "tone_stream.h"
+
+static const char *TAG = "TONE_STREAM";
+
+typedef struct tone_stream {
+    tone_stream_cfg_t   cfg;
+    tone_gen_t          gen;
+    int64_t             start_us;
+    int64_t             frames_out;
+    int64_t             paused_us;
+} tone_stream_t;
+
+static esp_err_t _tone_open(audio_element_handle_t self)
+{
+    tone_stream_t *t = (tone_stream_t *)audio_element_getdata(self);
+    if (AEL_STATE_PAUSED == audio_element_get_state(self)) {
+        // resume, keep the phase and move the realtime clock past the pause instead of catching up
+        t->start_us += esp_timer_get_time() - t->paused_us;
+        return ESP_OK;
+    }
+    if (tone_gen_init(&t->gen, &t->cfg.gen) != 0) {
+        ESP_LOGE(TAG, "Invalid test signal configuration, type %d", t->cfg.gen.type);
+        return ESP_FAIL;
+    }
+    t->frames_out = 0;
+    t->start_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static int _tone_process(audio_element_handle_t self, char *in_buffer, int in_len)
+{
+    tone_stream_t *t = (tone_stream_t *)audio_element_getdata(self);
+    int frame_bytes = 2 * t->cfg.gen.channels;
+    int frames = in_len / frame_bytes;
+    if (t->cfg.realtime) {
+        int64_t due_us = t->start_us + (t->frames_out + frames) * 1000000 / t->cfg.gen.sample_rate;
+        int64_t wait_us = due_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            vTaskDelay((wait_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000));
+        }
+    }
+    tone_gen_fill(&t->gen, (int16_t *)in_buffer, frames);
+    t->frames_out += frames;
+    int w_size = audio_element_output(self, in_buffer, frames * frame_bytes);
+    if (w_size > 0) {
+        audio_element_update_byte_pos(self, w_size);
+    }
+    return w_size;
+}
+
+static esp_err_t _tone_close(audio_element_handle_t self)
+{
+    tone_stream_t *t = (tone_stream_t *)audio_element_getdata(self);
+    if (AEL_STATE_PAUSED != audio_element_get_state(self)) {
+        audio_element_report_info(self);
+        audio_element_set_byte_pos(self, 0);
+    } else {
+        t->paused_us = esp_timer_get_time();
+    }
+    return ESP_OK;
+}
+
+static esp_err_t _tone_destroy(audio_element_handle_t self)
+{
+    tone_stream_t *t = (tone_stream_t *)audio_element_getdata(self);
+    audio_free(t);
+    return ESP_OK;
+}
+
+audio_element_handle_t tone_stream_init(tone_stream_cfg_t *config)
+{
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    tone_stream_t *t = audio_calloc(1, sizeof(tone_stream_t));
+    AUDIO_MEM_CHECK(TAG, t, return NULL);
+    memcpy(&t->cfg, config, sizeof(tone_stream_cfg_t));
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _tone_open;
+    cfg.close = _tone_close;
+    cfg.process = _tone_process;
+    cfg.destroy = _tone_destroy;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.buffer_len = config->buffer_len;
+    cfg.tag = "tone";
+    audio_element_handle_t el = audio_element_init(&cfg);
+    AUDIO_MEM_CHECK(TAG, el, {
+        audio_free(t);
+        return NULL;
+    });
+    audio_element_setdata(el, t);
+
+    audio_element_info_t info = {0};
+    audio_element_getinfo(el, &info);
+    info.sample_rates = config->gen.sample_rate;
+    info.channels = config->gen.channels;
+    info.bits = 16;
+    audio_element_setinfo(el, &info);
+    return el;
+}
@@ -0,0 +1,66 @@
+#ifndef _TONE_STREAM_H_
+#define _TONE_STREAM_H_
+
+#include "audio_element.h"
+#include "tone_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Test signal source configuration
+ *
+ *          Drop-in replacement for an i2s_stream reader: same 16 bit interleaved output,
+ *          paced to the sample rate, but the samples come from tone_gen instead of the codec.
+ */
+typedef struct {
+    tone_gen_cfg_t  gen;            /*!< Signal to generate */
+    bool            realtime;       /*!< Pace output to the sample rate, false runs as fast as the sink allows */
+    int             buffer_len;     /*!< Bytes generated per process call */
+    int             out_rb_size;    /*!< Output ringbuffer size */
+    int             task_stack;     /*!< Task stack size */
+    int             task_core;      /*!< Task running in core */
+    int             task_prio;      /*!< Task priority */
+} tone_stream_cfg_t;
+
+#define TONE_STREAM_TASK_STACK      (3 * 1024)
+#define TONE_STREAM_TASK_CORE       (0)
+#define TONE_STREAM_TASK_PRIO       (23)
+#define TONE_STREAM_BUF_SIZE        (2048)
+#define TONE_STREAM_RINGBUFFER_SIZE (8 * 1024)
+
+#define TONE_STREAM_CFG_DEFAULT() {                 \
+    .gen = {                                        \
+        .type = TONE_GEN_SINE,                      \
+        .sample_rate = 16000,                       \
+        .channels = 1,                              \
+        .amplitude = 16384,                         \
+        .freq_hz = TONE_GEN_FFT_TARGET_HZ,          \
+        .freq_end_hz = 4000,                        \
+        .period_ms = 1000,                          \
+        .on_ms = 300,                               \
+        .off_ms = 200,                              \
+    },                                              \
+    .realtime = true,                               \
+    .buffer_len = TONE_STREAM_BUF_SIZE,             \
+    .out_rb_size = TONE_STREAM_RINGBUFFER_SIZE,     \
+    .task_stack = TONE_STREAM_TASK_STACK,           \
+    .task_core = TONE_STREAM_TASK_CORE,             \
+    .task_prio = TONE_STREAM_TASK_PRIO,             \
+}
+
+/**
+ * @brief      Create a test signal source
+ *
+ * @param      config  The configuration
+ *
+ * @return     The audio element handle, NULL on failure
+ */
+audio_element_handle_t tone_stream_init(tone_stream_cfg_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
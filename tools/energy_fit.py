@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Fit energy_model.h coefficients to power meter measurements.
+
+Input is a CSV of the ENERGY lines printed by energy_model_report() with the
+energy measured by the power meter over the same window appended as the last
+column, in mJ:
+
+    ENERGY,scenario,seconds,wall_us,mhz,light_sleep,busy_us,idle_us,sd_bytes,sd_busy_us,tx_bytes,radio_us,est_mj,measured_mj
+
+The fit is a least squares solve pulled towards the current coefficients, so
+components that no run exercised keep their default value. The result is
+printed as a replacement for ENERGY_COEFFS_DEFAULT().
+
+    python3 tools/energy_fit.py runs.csv
+"""
+import csv
+import sys
+
+# name, default, feature(row) in the unit that makes feature * coefficient come out in mJ
+COEFFS = [
+    ("base_mw", 60.0, lambda r: r["wall_s"]),
+    ("cpu_active_mw", 30.0, lambda r: r["busy_s"]),
+    ("cpu_mw_per_mhz", 0.25, lambda r: r["busy_s"] * r["mhz"]),
+    ("cpu_idle_mw", 25.0, lambda r: r["idle_s"] * (1 - r["light_sleep"])),
+    ("light_sleep_mw", 2.5, lambda r: r["idle_s"] * r["light_sleep"]),
+    ("sd_nj_per_byte", 40.0, lambda r: r["sd_bytes"] / 1e6),
+    ("sd_busy_mw", 100.0, lambda r: r["sd_busy_s"]),
+    ("wifi_tx_nj_per_byte", 120.0, lambda r: r["tx_bytes"] / 1e6),
+    ("wifi_radio_mw", 330.0, lambda r: r["radio_s"]),
+]
+PRIOR_WEIGHT = 1e-3
+
+
+def read_rows(path):
+    rows = []
+    with open(path, newline="") as f:
+        for line in csv.reader(f):
+            if not line or line[0].strip() != "ENERGY":
+                continue
+            if len(line) < 14:
+                sys.exit("%s: ENERGY line without a measured_mj column: %s" % (path, ",".join(line)))
+            v = [float(x) for x in line[2:14]]
+            rows.append({
+                "scenario": line[1],
+                "wall_s": v[1] / 1e6,
+                "mhz": v[2],
+                "light_sleep": v[3],
+                "busy_s": v[4] / 1e6,
+                "idle_s": v[5] / 1e6,
+                "sd_bytes": v[6],
+                "sd_busy_s": v[7] / 1e6,
+                "tx_bytes": v[8],
+                "radio_s": v[9] / 1e6,
+                "est_mj": v[10],
+                "measured_mj": v[11],
+            })
+    return rows
+
+
+def solve(a, b):
+    n = len(b)
+    m = [row[:] + [b[i]] for i, row in enumerate(a)]
+    for col in range(n):
+        pivot = max(range(col, n), key=lambda r: abs(m[r][col]))
+        if abs(m[pivot][col]) < 1e-18:
+            sys.exit("singular system, add more varied runs")
+        m[col], m[pivot] = m[pivot], m[col]
+        for r in range(n):
+            if r != col:
+                f = m[r][col] / m[col][col]
+                for c in range(col, n + 1):
+                    m[r][c] -= f * m[col][c]
+    return [m[i][n] / m[i][i] for i in range(n)]
+
+
+def fit(rows):
+    x = [[feat(r) for _, _, feat in COEFFS] for r in rows]
+    y = [r["measured_mj"] for r in rows]
+    n = len(COEFFS)
+    # scale the prior per column so it only matters where the data says nothing
+    scale = [max(sum(xi[j] ** 2 for xi in x), 1e-12) for j in range(n)]
+    a = [[sum(xi[i] * xi[j] for xi in x) for j in range(n)] for i in range(n)]
+    b = [sum(xi[i] * yi for xi, yi in zip(x, y)) for i in range(n)]
+    for j, (_, default, _) in enumerate(COEFFS):
+        a[j][j] += PRIOR_WEIGHT * scale[j]
+        b[j] += PRIOR_WEIGHT * scale[j] * default
+    coeffs = solve(a, b)
+    for j, (name, _, _) in enumerate(COEFFS):
+        if coeffs[j] < 0:
+            print("warning: %s came out negative (%.3f), clamped to 0" % (name, coeffs[j]), file=sys.stderr)
+            coeffs[j] = 0.0
+    return coeffs
+
+
+def c_float(v):
+    s = "%.4g" % v
+    if "." not in s and "e" not in s:
+        s += ".0"
+    return s + "f"
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    rows = read_rows(sys.argv[1])
+    if len(rows) < 2:
+        sys.exit("need at least two ENERGY lines with measurements")
+    coeffs = fit(rows)
+
+    print("%-24s %10s %10s %10s" % ("scenario", "measured", "before", "after"))
+    for r in rows:
+        after = sum(c * feat(r) for c, (_, _, feat) in zip(coeffs, COEFFS))
+        print("%-24s %10.1f %10.1f %10.1f" % (r["scenario"], r["measured_mj"], r["est_mj"], after))
+
+    print()
+    print("#define ENERGY_COEFFS_DEFAULT() {   \\")
+    for (name, _, _), c in zip(COEFFS, coeffs):
+        print("    %-30s\\" % (".%s = %s," % (name, c_float(c))))
+    print("}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""Receiver for spool_stream.c, with outages on demand.
+
+Every session the device opens is written to <out>/<session>.bin. On each
+connection the device sends "SPL1" and a 64-bit session id, the receiver
+answers with the number of bytes it already holds for that session and then
+keeps sending that count as data arrives; all numbers are big endian.
+
+--outage-every drops the connection every N seconds (jittered) and refuses
+connections for --outage-ms. Before the drop the receiver stops reading for
+STALL_SECONDS, so the device's TCP stack has accepted data that is then lost
+with the socket, like in a real link drop.
+
+--throttle-kbps caps how fast the receiver reads, for checking that the
+device's bitrate control settles inside a slow link.
+
+When a session ends its byte count and CRC32 are printed in the same form as
+the device's "Session ..." log line. Afterwards, --expect with that line's
+values checks the received file against it and exits non-zero on a mismatch.
+
+    python3 tools/spool_receiver.py --port 8000 --out rx --outage-every 7 --outage-ms 3000
+    python3 tools/spool_receiver.py --port 8000 --throttle-kbps 16
+    python3 tools/spool_receiver.py --out rx --expect 1f2e3d4c5b6a7980:2822400:89abcdef
+"""
+import argparse
+import os
+import random
+import selectors
+import socket
+import struct
+import sys
+import time
+import zlib
+
+HELLO = b"SPL1"
+HELLO_LEN = 12
+ACK_BYTES = 4096
+ACK_SECONDS = 0.05
+STALL_SECONDS = 0.5
+
+
+class Session:
+    def __init__(self, sid, out_dir):
+        self.sid = sid
+        self.path = os.path.join(out_dir, "%016x.bin" % sid)
+        self.f = open(self.path, "wb")
+        self.size = 0
+        self.crc = 0
+        self.connections = 0
+
+    def write(self, data):
+        self.f.write(data)
+        self.f.flush()
+        self.size += len(data)
+        self.crc = zlib.crc32(data, self.crc)
+
+
+class Receiver:
+    def __init__(self, args):
+        self.args = args
+        self.sessions = {}
+        self.sel = selectors.DefaultSelector()
+        self.refuse_until = 0.0
+        self.next_outage = self._schedule()
+        self.stalled = False
+        os.makedirs(args.out, exist_ok=True)
+
+    def _schedule(self):
+        if not self.args.outage_every:
+            return float("inf")
+        return time.monotonic() + self.args.outage_every * random.uniform(0.5, 1.5)
+
+    def run(self):
+        lsock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        lsock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        lsock.bind(("", self.args.port))
+        lsock.listen(4)
+        lsock.setblocking(False)
+        self.sel.register(lsock, selectors.EVENT_READ, None)
+        print("listening on port %d, writing to %s" % (self.args.port, self.args.out))
+        try:
+            while True:
+                events = self.sel.select(timeout=ACK_SECONDS)
+                if self.stalled:
+                    time.sleep(ACK_SECONDS)
+                    events = [(k, e) for k, e in events if k.data is None]
+                for key, _ in events:
+                    if key.data is None:
+                        self._accept(key.fileobj)
+                    else:
+                        self._read(key.fileobj, key.data)
+                now = time.monotonic()
+                for key in list(self.sel.get_map().values()):
+                    if key.data is not None and key.data["session"] and now - key.data["acked_at"] >= ACK_SECONDS:
+                        self._ack(key.fileobj, key.data)
+                if now >= self.next_outage + STALL_SECONDS:
+                    self._outage(now)
+                elif now >= self.next_outage:
+                    self.stalled = True
+        except KeyboardInterrupt:
+            pass
+        for key in list(self.sel.get_map().values()):
+            if key.data is not None:
+                self._close(key.fileobj, key.data, "receiver stopped")
+        return 0
+
+    def _accept(self, lsock):
+        conn, addr = lsock.accept()
+        if time.monotonic() < self.refuse_until:
+            conn.close()
+            return
+        conn.setblocking(False)
+        self.sel.register(conn, selectors.EVENT_READ,
+                          {"addr": addr, "hello": b"", "session": None, "acked": -1, "acked_at": 0.0,
+                           "budget": 0.0, "budget_at": time.monotonic()})
+
+    def _read_len(self, st):
+        if not self.args.throttle_kbps or st["session"] is None:
+            return 65536
+        now = time.monotonic()
+        rate = self.args.throttle_kbps * 1000 / 8
+        # at most a quarter second of credit, a throttled link does not save up
+        st["budget"] = min(st["budget"] + (now - st["budget_at"]) * rate, rate / 4)
+        st["budget_at"] = now
+        return int(st["budget"])
+
+    def _read(self, conn, st):
+        n = self._read_len(st)
+        if n <= 0:
+            time.sleep(0.005)
+            return
+        try:
+            data = conn.recv(n)
+        except (BlockingIOError, InterruptedError):
+            return
+        except OSError as e:
+            self._close(conn, st, str(e))
+            return
+        if not data:
+            self._close(conn, st, "closed by device")
+            return
+        if st["session"] is None:
+            st["hello"] += data
+            if len(st["hello"]) < HELLO_LEN:
+                return
+            hello, data = st["hello"][:HELLO_LEN], st["hello"][HELLO_LEN:]
+            if hello[:4] != HELLO:
+                self._close(conn, st, "bad hello %r" % hello[:4])
+                return
+            sid = struct.unpack(">Q", hello[4:])[0]
+            if sid not in self.sessions:
+                self.sessions[sid] = Session(sid, self.args.out)
+            st["session"] = self.sessions[sid]
+            st["session"].connections += 1
+            print("%016x: connection %d from %s, resuming at %d"
+                  % (sid, st["session"].connections, st["addr"][0], st["session"].size))
+            # the first count tells the device where to resume, it must not send before it
+            self._ack(conn, st)
+        if data:
+            st["budget"] -= len(data)
+            st["session"].write(data)
+            if st["session"].size - st["acked"] >= ACK_BYTES:
+                self._ack(conn, st)
+
+    def _ack(self, conn, st):
+        st["acked_at"] = time.monotonic()
+        if st["acked"] == st["session"].size:
+            return
+        try:
+            conn.send(struct.pack(">Q", st["session"].size))
+            st["acked"] = st["session"].size
+        except OSError:
+            pass
+
+    def _outage(self, now):
+        dropped = 0
+        for key in list(self.sel.get_map().values()):
+            if key.data is not None:
+                # whatever the kernel still queues for us is lost with the socket
+                self.sel.unregister(key.fileobj)
+                key.fileobj.close()
+                dropped += 1
+        self.refuse_until = now + self.args.outage_ms / 1000.0
+        self.next_outage = self._schedule()
+        self.stalled = False
+        print("outage: dropped %d connection(s), refusing for %d ms" % (dropped, self.args.outage_ms))
+
+    def _close(self, conn, st, why):
+        self.sel.unregister(conn)
+        conn.close()
+        sess = st["session"]
+        if sess is None:
+            return
+        print("%016x: %s, %d bytes, crc32 %08x" % (sess.sid, why, sess.size, sess.crc))
+
+
+def check(out_dir, expect):
+    failed = 0
+    for item in expect:
+        sid, size, crc = item.split(":")
+        path = os.path.join(out_dir, "%016x.bin" % int(sid, 16))
+        try:
+            with open(path, "rb") as f:
+                data = f.read()
+        except OSError as e:
+            print("%s: %s" % (sid, e))
+            failed += 1
+            continue
+        got_crc = zlib.crc32(data)
+        if len(data) == int(size) and got_crc == int(crc, 16):
+            print("%s: MATCH %d bytes, crc32 %08x" % (sid, len(data), got_crc))
+        else:
+            print("%s: MISMATCH received %d bytes crc32 %08x, device sent %s bytes crc32 %s"
+                  % (sid, len(data), got_crc, size, crc))
+            failed += 1
+    return 1 if failed else 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--port", type=int, default=8000)
+    ap.add_argument("--out", default="spool_rx")
+    ap.add_argument("--outage-every", type=float, default=0, help="seconds between dropped connections, 0 never")
+    ap.add_argument("--outage-ms", type=int, default=3000, help="how long connections are refused after a drop")
+    ap.add_argument("--throttle-kbps", type=float, default=0, help="read at most this fast, 0 unlimited")
+    ap.add_argument("--expect", action="append", metavar="SESSION:BYTES:CRC32",
+                    help="check files in --out against the device's Session log line and exit, may be repeated")
+    args = ap.parse_args()
+    if args.expect:
+        sys.exit(check(args.out, args.expect))
+    sys.exit(Receiver(args).run())
+
+
+if __name__ == "__main__":
+    main()
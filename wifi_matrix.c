@@ -0,0 +1,416 @@
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_wifi.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#include "lwip/sockets.h"
+
+#include "sdkconfig.h"
+#include "audio_element.h"
+#include "audio_pipeline.h"
+#include "audio_event_iface.h"
+#include "audio_common.h"
+#include "audio_sys.h"
+#include "board.h"
+#include "esp_peripherals.h"
+#include "periph_wifi.h"
+#include "i2s_stream.h"
+#include "tone_stream.h"
+#include "opus_dyn_encoder.h"
+#include "esp_netif.h"
+#include "energy_model.h"
+
+
+static const char *TAG = "ESPEAR";
+#define SWEEP_SECONDS (10)
+// 1: replace the codec and i2s_stream_reader with a deterministic test signal
+#define TEST_SIGNAL_SOURCE (0)
+// 0: stream raw PCM like raw_wifi.c, 1: stream Opus like opus_wifi.c
+#define SWEEP_OPUS (0)
+#define SAMPLE_RATE (16000)
+#define SERVER_HOST "192.168.137.1"
+#define SERVER_PORT (8000)
+
+#define TCP_MSS_BYTES (CONFIG_LWIP_TCP_MSS)
+// Energy ranking: energy_model's awake radio power, plus the PA while on air
+#define RADIO_PA_EFFICIENCY_PCT (25)
+
+static const wifi_ps_type_t ps_modes[] = {WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM};
+// listen interval only has an effect in WIFI_PS_MAX_MODEM
+static const uint16_t listen_intervals[] = {3, 10};
+// unit is 0.25 dBm: 19.5, 15, 11 and 8 dBm
+static const int8_t tx_powers[] = {78, 60, 44, 32};
+/* lwIP has no runtime SO_SNDBUF (TCP_SND_BUF is CONFIG_LWIP_TCP_SND_BUF_DEFAULT),
+ * so the send buffer is swept as the amount of data handed to send() per call */
+static const int send_chunks[] = {TCP_MSS_BYTES, 2 * TCP_MSS_BYTES, 4 * TCP_MSS_BYTES};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+#define MAX_RUNS (ARRAY_LEN(tx_powers) * ARRAY_LEN(send_chunks) * (ARRAY_LEN(ps_modes) - 1 + ARRAY_LEN(listen_intervals)))
+
+typedef struct {
+    wifi_ps_type_t ps;
+    uint16_t listen_interval;
+    int8_t tx_power;
+    int send_chunk;
+    int sock;
+    char *stage;
+    int stage_len;
+    int send_errors;
+    int64_t bytes_sent;
+    int64_t blocked_us;
+    int64_t max_block_us;
+    int late_writes;
+    int64_t captured_bytes;
+    int64_t elapsed_us;
+} sweep_run_t;
+
+static sweep_run_t runs[MAX_RUNS];
+static sweep_run_t *cur_run;
+static int bytes_per_sec;
+// audio carried by one encoder write, the opus sweep gets one packet per callback
+static int packet_ms;
+
+static const char *ps_name(wifi_ps_type_t ps)
+{
+    switch (ps) {
+        case WIFI_PS_NONE:
+            return "NONE";
+        case WIFI_PS_MIN_MODEM:
+            return "MIN_MODEM";
+        default:
+            return "MAX_MODEM";
+    }
+}
+
+static int open_socket()
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(SERVER_PORT),
+    };
+    inet_pton(AF_INET, SERVER_HOST, &addr.sin_addr);
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (sock < 0) {
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "connect to %s:%d failed, errno %d", SERVER_HOST, SERVER_PORT, errno);
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void flush_stage(sweep_run_t *run)
+{
+    int off = 0;
+    int64_t start = esp_timer_get_time();
+    while (off < run->stage_len && run->sock >= 0) {
+        int sent = send(run->sock, run->stage + off, run->stage_len - off, 0);
+        if (sent < 0) {
+            run->send_errors++;
+            close(run->sock);
+            run->sock = -1;
+            break;
+        }
+        off += sent;
+    }
+    int64_t blocked = esp_timer_get_time() - start;
+    run->blocked_us += blocked;
+    if (blocked > run->max_block_us) {
+        run->max_block_us = blocked;
+    }
+    run->bytes_sent += off;
+    run->stage_len = 0;
+}
+
+audio_element_err_t cb_send(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context)
+{
+    sweep_run_t *run = cur_run;
+    int64_t start = esp_timer_get_time();
+    int off = 0;
+    while (off < len) {
+        int n = run->send_chunk - run->stage_len;
+        if (n > len - off) {
+            n = len - off;
+        }
+        memcpy(run->stage + run->stage_len, buffer + off, n);
+        run->stage_len += n;
+        off += n;
+        if (run->stage_len == run->send_chunk) {
+            flush_stage(run);
+        }
+    }
+    // the callback is late if it held the pipeline longer than the audio it carried
+    int64_t carried_us = SWEEP_OPUS ? packet_ms * 1000LL : (int64_t)len * 1000000 / bytes_per_sec;
+    if (esp_timer_get_time() - start > carried_us) {
+        run->late_writes++;
+    }
+    return len;
+}
+
+// the radio stays awake while send() blocks on top of what energy_model counts for the data
+static int64_t radio_active_us(const sweep_run_t *run)
+{
+    return energy_model_radio_us(run->ps, run->listen_interval, run->bytes_sent, run->blocked_us, run->elapsed_us);
+}
+
+// awake time at the receive power plus on-air time at the PA input power for the TX setting
+static int64_t radio_energy_uj(const sweep_run_t *run)
+{
+    energy_coeffs_t coeffs = ENERGY_COEFFS_DEFAULT();
+    float pa_mw = powf(10.0f, run->tx_power / 40.0f) * 100 / RADIO_PA_EFFICIENCY_PCT;
+    return (int64_t)(radio_active_us(run) * coeffs.wifi_radio_mw + energy_model_radio_tx_us(run->bytes_sent) * pa_mw) / 1000;
+}
+
+static void apply_link_params(esp_periph_handle_t wifi_handle, const sweep_run_t *run, uint16_t *cur_listen_interval)
+{
+    if (run->listen_interval != *cur_listen_interval) {
+        wifi_config_t sta_cfg;
+        esp_wifi_get_config(WIFI_IF_STA, &sta_cfg);
+        sta_cfg.sta.listen_interval = run->listen_interval;
+        esp_wifi_set_config(WIFI_IF_STA, &sta_cfg);
+        // listen interval is sent in the association request, periph_wifi reconnects on its own
+        esp_wifi_disconnect();
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+        periph_wifi_wait_for_connected(wifi_handle, portMAX_DELAY);
+        *cur_listen_interval = run->listen_interval;
+    }
+    ESP_ERROR_CHECK(esp_wifi_set_ps(run->ps));
+    ESP_ERROR_CHECK(esp_wifi_set_max_tx_power(run->tx_power));
+}
+
+static int build_runs()
+{
+    int n = 0;
+    for (int p = 0; p < ARRAY_LEN(ps_modes); p++) {
+        int li_count = ps_modes[p] == WIFI_PS_MAX_MODEM ? ARRAY_LEN(listen_intervals) : 1;
+        for (int l = 0; l < li_count; l++) {
+            for (int t = 0; t < ARRAY_LEN(tx_powers); t++) {
+                for (int c = 0; c < ARRAY_LEN(send_chunks); c++) {
+                    sweep_run_t *run = &runs[n++];
+                    memset(run, 0, sizeof(*run));
+                    run->ps = ps_modes[p];
+                    run->listen_interval = ps_modes[p] == WIFI_PS_MAX_MODEM ? listen_intervals[l] : listen_intervals[0];
+                    run->tx_power = tx_powers[t];
+                    run->send_chunk = send_chunks[c];
+                    run->sock = -1;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+void app_main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        // NVS partition was truncated and needs to be erased
+        // Retry nvs_flash_init
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+    ESP_ERROR_CHECK(esp_netif_init());
+
+    audio_pipeline_handle_t pipeline;
+    audio_element_handle_t i2s_stream_reader, opus_encoder = NULL;
+
+    ESP_LOGI(TAG, "[ 1 ] Connect to WIFI");
+    esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
+    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
+    periph_wifi_cfg_t wifi_cfg = {
+        .wifi_config.sta.ssid = CONFIG_WIFI_SSID,
+        .wifi_config.sta.password = CONFIG_WIFI_PASSWORD,
+        .wifi_config.sta.listen_interval = listen_intervals[0],
+    };
+    esp_periph_handle_t wifi_handle = periph_wifi_init(&wifi_cfg);
+
+    esp_periph_start(set, wifi_handle);
+    periph_wifi_wait_for_connected(wifi_handle, portMAX_DELAY);
+    uint16_t cur_listen_interval = listen_intervals[0];
+
+#if !TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[ 2 ] Start codec chip");
+    audio_board_handle_t board_handle = audio_board_init();
+
+    // change input to aux in
+    audio_hal_deinit(board_handle->audio_hal);
+    audio_hal_codec_config_t audio_codec_cfg = AUDIO_CODEC_DEFAULT_CONFIG();
+    audio_codec_cfg.adc_input = AUDIO_HAL_ADC_INPUT_LINE2;
+    board_handle->audio_hal = audio_hal_init(&audio_codec_cfg, &AUDIO_CODEC_ES8388_DEFAULT_HANDLE);
+
+    audio_hal_ctrl_codec(board_handle->audio_hal, AUDIO_HAL_CODEC_MODE_ENCODE, AUDIO_HAL_CTRL_START);
+#endif
+
+    ESP_LOGI(TAG, "[2.0] Create audio pipeline for listening");
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    pipeline = audio_pipeline_init(&pipeline_cfg);
+    mem_assert(pipeline);
+
+#if TEST_SIGNAL_SOURCE
+    ESP_LOGI(TAG, "[2.1] Create test signal source in place of the codec");
+    tone_stream_cfg_t tone_cfg = TONE_STREAM_CFG_DEFAULT();
+    tone_cfg.gen.sample_rate = SAMPLE_RATE;
+    i2s_stream_reader = tone_stream_init(&tone_cfg);
+#else
+    ESP_LOGI(TAG, "[2.1] Create i2s stream to read audio data from codec chip");
+    i2s_stream_cfg_t i2s_cfg = I2S_STREAM_CFG_DEFAULT();
+    i2s_cfg.std_cfg.slot_cfg.slot_mode = I2S_SLOT_MODE_MONO;
+    i2s_cfg.std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+    i2s_cfg.type = AUDIO_STREAM_READER;
+    i2s_cfg.std_cfg.clk_cfg.sample_rate_hz = SAMPLE_RATE;
+    i2s_stream_reader = i2s_stream_init(&i2s_cfg);
+#endif
+    audio_pipeline_register(pipeline, i2s_stream_reader, "i2s");
+
+    if (SWEEP_OPUS) {
+        ESP_LOGI(TAG, "[2.2] Create opus encoder");
+        opus_dyn_encoder_cfg_t opus_cfg = OPUS_DYN_ENCODER_CFG_DEFAULT();
+        opus_cfg.sample_rate = SAMPLE_RATE;
+        packet_ms = opus_cfg.frame_ms;
+        opus_encoder = opus_dyn_encoder_init(&opus_cfg);
+        audio_pipeline_register(pipeline, opus_encoder, "enc");
+        const char *link_tag_main[2] = {"i2s", "enc"};
+        audio_pipeline_link(pipeline, &link_tag_main[0], 2);
+        audio_element_set_write_cb(opus_encoder, cb_send, NULL);
+    } else {
+        const char *link_tag_main[1] = {"i2s"};
+        audio_pipeline_link(pipeline, &link_tag_main[0], 1);
+        audio_element_set_write_cb(i2s_stream_reader, cb_send, NULL);
+    }
+
+    audio_element_info_t music_info = {0};
+    audio_element_getinfo(i2s_stream_reader, &music_info);
+    bytes_per_sec = music_info.channels * (music_info.bits / 8) * music_info.sample_rates;
+
+    ESP_LOGI(TAG, "[ 3 ] Set up  event listener");
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    audio_pipeline_set_listener(pipeline, evt);
+
+    char *stage = malloc(send_chunks[ARRAY_LEN(send_chunks) - 1]);
+    mem_assert(stage);
+
+    int run_count = build_runs();
+    bool started = false;
+    ESP_LOGI(TAG, "[ 4 ] Sweep %d link configurations, %d Seconds each", run_count, SWEEP_SECONDS);
+    for (int r = 0; r < run_count; r++) {
+        sweep_run_t *run = &runs[r];
+        apply_link_params(wifi_handle, run, &cur_listen_interval);
+        run->stage = stage;
+        run->sock = open_socket();
+        if (run->sock < 0) {
+            run->send_errors++;
+            continue;
+        }
+        cur_run = run;
+
+        audio_element_getinfo(i2s_stream_reader, &music_info);
+        int64_t start_pos = music_info.byte_pos;
+        int64_t start_us = esp_timer_get_time();
+        if (!started) {
+            audio_pipeline_run(pipeline);
+            started = true;
+        } else {
+            audio_pipeline_resume(pipeline);
+        }
+
+        while (esp_timer_get_time() - start_us < SWEEP_SECONDS * 1000000LL) {
+            audio_event_iface_msg_t msg;
+            audio_event_iface_listen(evt, &msg, 100 / portTICK_PERIOD_MS);
+        }
+        audio_pipeline_pause(pipeline);
+        flush_stage(run);
+
+        audio_element_getinfo(i2s_stream_reader, &music_info);
+        run->captured_bytes = music_info.byte_pos - start_pos;
+        run->elapsed_us = esp_timer_get_time() - start_us;
+        if (run->sock >= 0) {
+            close(run->sock);
+            run->sock = -1;
+        }
+
+        int64_t expected = run->elapsed_us * bytes_per_sec / 1000000;
+        ESP_LOGI(TAG, "[ * ] ps=%s li=%d tx=%d chunk=%d: %lld kbps, blocked %lld ms (max %lld), radio ~%lld ms, overrun %lld ms, late %d, errors %d",
+                 ps_name(run->ps), run->listen_interval, run->tx_power, run->send_chunk,
+                 run->bytes_sent * 8000 / run->elapsed_us, run->blocked_us / 1000, run->max_block_us / 1000,
+                 radio_active_us(run) / 1000, (expected - run->captured_bytes) * 1000 / bytes_per_sec,
+                 run->late_writes, run->send_errors);
+    }
+
+    ESP_LOGI(TAG, "[ 5 ] Results");
+    printf("CSV,codec,ps,listen_interval,tx_power_qdbm,send_chunk,kbps,blocked_ms,max_block_ms,radio_ms,radio_mj,overrun_ms,late_writes,send_errors\n");
+    int best = -1;
+    for (int r = 0; r < run_count; r++) {
+        sweep_run_t *run = &runs[r];
+        if (run->elapsed_us == 0) {
+            printf("CSV,%s,%s,%d,%d,%d,,,,,,,,%d\n", SWEEP_OPUS ? "opus" : "raw", ps_name(run->ps),
+                   run->listen_interval, run->tx_power, run->send_chunk, run->send_errors);
+            continue;
+        }
+        int64_t expected = run->elapsed_us * bytes_per_sec / 1000000;
+        int64_t overrun_ms = (expected - run->captured_bytes) * 1000 / bytes_per_sec;
+        printf("CSV,%s,%s,%d,%d,%d,%lld,%lld,%lld,%lld,%lld,%lld,%d,%d\n", SWEEP_OPUS ? "opus" : "raw", ps_name(run->ps),
+               run->listen_interval, run->tx_power, run->send_chunk, run->bytes_sent * 8000 / run->elapsed_us,
+               run->blocked_us / 1000, run->max_block_us / 1000, radio_active_us(run) / 1000,
+               radio_energy_uj(run) / 1000, overrun_ms, run->late_writes, run->send_errors);
+        // real time means nothing lost at the source and nothing left undelivered
+        bool realtime = run->send_errors == 0 && run->late_writes == 0 && overrun_ms <= 20;
+        if (!realtime) {
+            continue;
+        }
+        // equal estimates go to the lower TX power, the model cannot tell them apart but the PA can
+        int64_t e = radio_energy_uj(run);
+        int64_t e_best = best < 0 ? 0 : radio_energy_uj(&runs[best]);
+        if (best < 0 || e < e_best || (e == e_best && run->tx_power < runs[best].tx_power)) {
+            best = r;
+        }
+    }
+    if (best >= 0) {
+        ESP_LOGI(TAG, "[ * ] Lowest-energy real-time configuration: ps=%s li=%d tx=%d chunk=%d, radio ~%lld mJ",
+                 ps_name(runs[best].ps), runs[best].listen_interval, runs[best].tx_power, runs[best].send_chunk,
+                 radio_energy_uj(&runs[best]) / 1000);
+    } else {
+        ESP_LOGW(TAG, "[ * ] No configuration kept up in real time");
+    }
+
+    ESP_LOGI(TAG, "[ 6 ] Stop audio_pipeline");
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    audio_pipeline_terminate(pipeline);
+
+    audio_pipeline_unregister(pipeline, i2s_stream_reader);
+    if (opus_encoder) {
+        audio_pipeline_unregister(pipeline, opus_encoder);
+    }
+
+    /* Terminal the pipeline before removing the listener */
+    audio_pipeline_remove_listener(pipeline);
+
+    /* Stop all periph before removing the listener */
+    esp_periph_set_stop_all(set);
+
+    /* Make sure audio_pipeline_remove_listener & audio_event_iface_remove_listener are called before destroying event_iface */
+    audio_event_iface_destroy(evt);
+
+    /* Release all resources */
+    audio_pipeline_deinit(pipeline);
+    audio_element_deinit(i2s_stream_reader);
+    if (opus_encoder) {
+        audio_element_deinit(opus_encoder);
+    }
+    free(stage);
+
+    esp_periph_set_destroy(set);
+}
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "driver/i2s_std.h"
+
+#include "board.h"
+#include "audio_mem.h"
+#include "audio_error.h"
+#include "buf_pool.h"
+#include "zc_capture.h"
+
+static const char *TAG = "ZC_CAPTURE";
+
+#define ZC_READ_TIMEOUT_MS (100)
+
+struct zc_capture {
+    zc_capture_cfg_t    cfg;
+    i2s_chan_handle_t   rx;
+    buf_pool_handle_t   pool;
+    uint8_t             *scratch;       /*!< Read target while the pool is empty, keeps the DMA draining */
+    volatile bool       running;
+    SemaphoreHandle_t   capture_done;
+    SemaphoreHandle_t   writer_done;
+    volatile bool       capture_exited;
+    portMUX_TYPE        lock;           /*!< stats are 64 bit and updated from both tasks */
+    zc_capture_stats_t  stats;
+};
+
+static void zc_capture_task(void *arg)
+{
+    struct zc_capture *zc = (struct zc_capture *)arg;
+    while (zc->running) {
+        buf_pool_buf_t *buf = buf_pool_get(zc->pool, 0);
+        uint8_t *dst = buf ? buf->data : zc->scratch;
+        size_t got = 0;
+        esp_err_t ret = i2s_channel_read(zc->rx, dst, zc->cfg.block_size, &got, ZC_READ_TIMEOUT_MS);
+        if (ret != ESP_OK && ret != ESP_ERR_TIMEOUT) {
+            ESP_LOGE(TAG, "i2s_channel_read failed, %s", esp_err_to_name(ret));
+        }
+        portENTER_CRITICAL(&zc->lock);
+        zc->stats.captured_bytes += got;
+        zc->stats.copy_bytes += got;
+        if (buf == NULL) {
+            zc->stats.dropped_bytes += got;
+        }
+        portEXIT_CRITICAL(&zc->lock);
+        if (buf == NULL) {
+            continue;
+        }
+        // an empty buffer still goes through the writer, which owns the way back to the free list
+        buf->len = got;
+        buf_pool_submit(zc->pool, buf);
+    }
+    zc->capture_exited = true;
+    xSemaphoreGive(zc->capture_done);
+    vTaskDelete(NULL);
+}
+
+static void zc_writer_task(void *arg)
+{
+    struct zc_capture *zc = (struct zc_capture *)arg;
+    while (1) {
+        // sampled before the take, so an empty queue after the capture task exits really is the end
+        bool last = zc->capture_exited;
+        buf_pool_buf_t *buf = buf_pool_take(zc->pool, pdMS_TO_TICKS(ZC_READ_TIMEOUT_MS));
+        if (buf == NULL) {
+            if (last) {
+                break;
+            }
+            continue;
+        }
+        if (buf->len > 0) {
+            int n = zc->cfg.sink(buf->data, buf->len, zc->cfg.sink_ctx);
+            portENTER_CRITICAL(&zc->lock);
+            if (n < 0) {
+                zc->stats.sink_errors++;
+            } else {
+                zc->stats.written_bytes += n;
+            }
+            portEXIT_CRITICAL(&zc->lock);
+        }
+        buf_pool_release(zc->pool, buf);
+    }
+    xSemaphoreGive(zc->writer_done);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t zc_open_i2s(struct zc_capture *zc)
+{
+    board_i2s_pin_t pins = {0};
+    if (get_i2s_pins(zc->cfg.port, &pins) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(zc->cfg.port, I2S_ROLE_MASTER);
+    // DMA ring deep enough to ride out one sink buffer being written
+    chan_cfg.dma_desc_num = 6;
+    chan_cfg.dma_frame_num = zc->cfg.block_size / 2 / 2;
+    if (i2s_new_channel(&chan_cfg, NULL, &zc->rx) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = I2S_STD_CLK_DEFAULT_CONFIG(zc->cfg.sample_rate),
+        .slot_cfg = I2S_STD_PHILIPS_SLOT_DEFAULT_CONFIG(I2S_DATA_BIT_WIDTH_16BIT, I2S_SLOT_MODE_MONO),
+        .gpio_cfg = {
+            .mclk = pins.mck_io_num,
+            .bclk = pins.bck_io_num,
+            .ws = pins.ws_io_num,
+            .dout = I2S_GPIO_UNUSED,
+            .din = pins.data_in_num,
+        },
+    };
+    std_cfg.slot_cfg.slot_mask = I2S_STD_SLOT_LEFT;
+    if (i2s_channel_init_std_mode(zc->rx, &std_cfg) != ESP_OK || i2s_channel_enable(zc->rx) != ESP_OK) {
+        i2s_del_channel(zc->rx);
+        zc->rx = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static void zc_free(struct zc_capture *zc)
+{
+    if (zc->rx) {
+        i2s_channel_disable(zc->rx);
+        i2s_del_channel(zc->rx);
+    }
+    if (zc->pool) {
+        buf_pool_destroy(zc->pool);
+    }
+    if (zc->capture_done) {
+        vSemaphoreDelete(zc->capture_done);
+    }
+    if (zc->writer_done) {
+        vSemaphoreDelete(zc->writer_done);
+    }
+    audio_free(zc->scratch);
+    audio_free(zc);
+}
+
+zc_capture_handle_t zc_capture_start(zc_capture_cfg_t *config)
+{
+    AUDIO_NULL_CHECK(TAG, config, return NULL);
+    AUDIO_NULL_CHECK(TAG, config->sink, return NULL);
+    struct zc_capture *zc = audio_calloc(1, sizeof(struct zc_capture));
+    AUDIO_MEM_CHECK(TAG, zc, return NULL);
+    memcpy(&zc->cfg, config, sizeof(zc_capture_cfg_t));
+    zc->lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    zc->pool = buf_pool_create(config->block_count, config->block_size);
+    zc->scratch = audio_malloc(config->block_size);
+    zc->capture_done = xSemaphoreCreateBinary();
+    zc->writer_done = xSemaphoreCreateBinary();
+    if (zc->pool == NULL || zc->scratch == NULL || zc->capture_done == NULL || zc->writer_done == NULL) {
+        ESP_LOGE(TAG, "No memory for the capture buffers");
+        zc_free(zc);
+        return NULL;
+    }
+    if (zc_open_i2s(zc) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open I2S%d", config->port);
+        zc_free(zc);
+        return NULL;
+    }
+    zc->running = true;
+    if (xTaskCreatePinnedToCore(zc_writer_task, "zc_wr", config->task_stack + 1024, zc,
+                                config->task_prio - 1, NULL, config->task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        zc_free(zc);
+        return NULL;
+    }
+    if (xTaskCreatePinnedToCore(zc_capture_task, "zc_cap", config->task_stack, zc,
+                                config->task_prio, NULL, config->task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create capture task");
+        zc->capture_exited = true;
+        xSemaphoreTake(zc->writer_done, portMAX_DELAY);
+        zc_free(zc);
+        return NULL;
+    }
+    return zc;
+}
+
+void zc_capture_get_stats(zc_capture_handle_t zc, zc_capture_stats_t *stats)
+{
+    buf_pool_stats_t ps;
+    buf_pool_get_stats(zc->pool, &ps);
+    portENTER_CRITICAL(&zc->lock);
+    memcpy(stats, &zc->stats, sizeof(*stats));
+    portEXIT_CRITICAL(&zc->lock);
+    stats->in_flight_max = ps.count - ps.free_min;
+    stats->ownership_errors = ps.ownership_errors;
+}
+
+void zc_capture_stop(zc_capture_handle_t zc, zc_capture_stats_t *stats)
+{
+    zc->running = false;
+    xSemaphoreTake(zc->capture_done, portMAX_DELAY);
+    xSemaphoreTake(zc->writer_done, portMAX_DELAY);
+    if (stats) {
+        zc_capture_get_stats(zc, stats);
+    }
+    zc_free(zc);
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef _ZC_CAPTURE_H_
+#define _ZC_CAPTURE_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief   Raw capture without the ADF element chain
+ *
+ *          The I2S driver copies DMA data straight into a pooled buffer, and that buffer
+ *          is handed by reference to the sink, which writes it out from the same memory.
+ *          i2s_stream -> ringbuffer -> writer costs three copies per byte before the sink
+ *          sees it; this path costs the one copy out of the DMA descriptors.
+ */
+typedef struct zc_capture *zc_capture_handle_t;
+
+/**
+ * @brief      Sink callback, runs in the writer task and may block
+ *
+ * @param      data  Samples, only valid until the callback returns
+ * @param      len   Bytes, a multiple of the sample size
+ * @param      ctx   sink_ctx from the configuration
+ *
+ * @return     Bytes written, < 0 on error, the block is dropped either way
+ */
+typedef int (*zc_capture_sink_t)(const uint8_t *data, int len, void *ctx);
+
+typedef struct {
+    int                 port;           /*!< I2S port, pins come from the board definition */
+    int                 sample_rate;
+    int                 block_size;     /*!< Bytes per pooled buffer, keep it a multiple of 512 for the SD card */
+    int                 block_count;    /*!< Pooled buffers, covers block_count * block_size of sink stall */
+    zc_capture_sink_t   sink;
+    void                *sink_ctx;
+    int                 task_stack;
+    int                 task_core;
+    int                 task_prio;      /*!< Capture task, the writer runs one below */
+} zc_capture_cfg_t;
+
+typedef struct {
+    int64_t captured_bytes;     /*!< Read from I2S */
+    int64_t written_bytes;      /*!< Accepted by the sink */
+    int64_t dropped_bytes;      /*!< Read while every buffer was with the sink */
+    int64_t copy_bytes;         /*!< Bytes moved by memcpy on the way, only the DMA read */
+    int     sink_errors;
+    int     in_flight_max;      /*!< Most buffers held by the sink side at once */
+    int     ownership_errors;
+} zc_capture_stats_t;
+
+#define ZC_CAPTURE_TASK_STACK   (3 * 1024)
+#define ZC_CAPTURE_TASK_CORE    (0)
+#define ZC_CAPTURE_TASK_PRIO    (23)
+
+#define ZC_CAPTURE_CFG_DEFAULT() {              \
+    .port = 0,                                  \
+    .sample_rate = 16000,                       \
+    .block_size = 4096,                         \
+    .block_count = 8,                           \
+    .sink = NULL,                               \
+    .sink_ctx = NULL,                           \
+    .task_stack = ZC_CAPTURE_TASK_STACK,        \
+    .task_core = ZC_CAPTURE_TASK_CORE,          \
+    .task_prio = ZC_CAPTURE_TASK_PRIO,          \
+}
+
+/**
+ * @brief      Open the I2S channel (16 bit mono, left slot) and start the capture and writer tasks
+ *
+ * @param      config  The configuration
+ *
+ * @return     The capture handle, NULL on failure
+ */
+zc_capture_handle_t zc_capture_start(zc_capture_cfg_t *config);
+
+/**
+ * @brief      Stop reading, let the sink finish every queued buffer, then release everything
+ *
+ * @param      zc     The capture handle
+ * @param      stats  Final counters, may be NULL
+ */
+void zc_capture_stop(zc_capture_handle_t zc, zc_capture_stats_t *stats);
+
+/**
+ * @brief      Read the counters while running
+ */
+void zc_capture_get_stats(zc_capture_handle_t zc, zc_capture_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
\ No newline at end of file